@@ -25,6 +25,7 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <algorithm>
 
 typedef handle<int,int(*)(int)> unix_file_handle;
 typedef handle<int,irods::error(*)(int)> isilon_file_handle;
@@ -35,6 +36,13 @@ typedef handle<class isilonConnectionDesc **,irods::error(*)(class isilonConnect
 static int NEXT_OBJ_DESC_NUM = 0;
 synchro_map<int, class isilonObjectDesc*> OBJ_DESC_MAP;
 synchro_map<std::string, class isilonConnectionDesc*> CONNECTION_DESC_MAP;
+isilonBlockCache BLOCK_CACHE;
+isilonLatencyTracker READ_LATENCY;
+isilonHedger HEDGER;
+isilonNodeStats NODE_STATS;
+isilonParallelReaders PARALLEL_READERS;
+isilonFilePrefetcher FILE_PREFETCHER;
+isilonWriteCache WRITE_CACHE;
 const char *HDFS_CLIENT = "HADOOFUS_CLIENT";
 
 /**
@@ -178,6 +186,7 @@ ISILON_LOCAL irods::error isilonDestroyObjDesc( int num)
     isilonObjectDesc *obj_desc = OBJ_DESC_MAP.at( num);
 
     OBJ_DESC_MAP.erase( num);
+    PARALLEL_READERS.remove( obj_desc->getPath(), num);
 #ifdef ISILON_DEBUG
     std::string obj_type_str = isilonGetObjType( obj_desc);
 #endif
@@ -285,19 +294,56 @@ ISILON_LOCAL void isilonFreeHDFSObjs( int n, ...)
 }
 
 /**
- * Compose a key to address connection object in a map
+ * Get monotonic time in seconds
  */
-ISILON_LOCAL std::string isilonGetConnectionKey( class isilonConnectionDesc* connection)
+ISILON_LOCAL double isilonGetTime()
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Compose a key to address connection object in a map out of
+ * connection parameters
+ */
+ISILON_LOCAL std::string isilonComposeConnectionKey( const std::string& host_name,
+                                                     unsigned long port_num,
+                                                     const std::string& user_name,
+                                                     unsigned long buff_size,
+                                                     const isilonIOParams& io_params)
 {
+    /* We convert here numerical port back to string and don't use original string
+       representation, because several original string representations may
+       correspond to the same integer number */
     std::stringstream ss;
-    std::string port_str, buff_size_str;
-    
-    ss << connection->getPort();
-    ss >> port_str;
-    ss << connection->getBuffSize();
-    ss >> buff_size_str;
 
-    return buff_size_str + connection->getHost() + port_str + connection->getUser();
+    ss << buff_size << host_name << port_num << user_name
+       << (io_params.read_ahead ? "+ra" : "") << "+rt" << io_params.read_threads
+       << (io_params.read_mode == ISILON_READ_RANDOM ? "+rnd" : "")
+       << "+bc" << io_params.block_cache_size << "+rh" << io_params.read_history
+       << (io_params.verify_checksums ? "+crc" : "")
+       << (io_params.hedged_reads ? "+hr" : "") << io_params.hedge_percentile
+       << "+er" << io_params.eager_read_size
+       << (io_params.align_fills ? "+al" : "") << "+pf" << io_params.prefetch_files
+       << "+wc" << io_params.write_cache_size << "+wb" << io_params.write_buffers
+       << (io_params.add_block_ahead ? "+aba" : "") << "+wbs" << io_params.write_buf_size;
+
+    return ss.str();
+}
+
+/**
+ * Compose a key to address connection object in a map
+ */
+ISILON_LOCAL std::string isilonGetConnectionKey( class isilonConnectionDesc* connection)
+{
+    return isilonComposeConnectionKey( connection->getHost(),
+                                       connection->getPort(),
+                                       connection->getUser(),
+                                       connection->getBuffSize(),
+                                       connection->getIOParams());
 }
 
 /**
@@ -420,6 +466,161 @@ ISILON_LOCAL irods::error isilonParseConnectionProps( irods::plugin_property_map
     return result;
 }
 
+/**
+ * Extract an on/off switch from iRODS property map
+ */
+ISILON_LOCAL bool isilonParseFlagProp( irods::plugin_property_map& prop_map,
+                                       const std::string& key,
+                                       bool default_val)
+{
+    std::string val_str;
+    irods::error local_res = prop_map.get<std::string>( key, val_str);
+
+    if ( !local_res.ok() )
+    {
+        return default_val;
+    }
+
+    if ( val_str == "1" || val_str == "on" || val_str == "yes" || val_str == "true" )
+    {
+        return true;
+    } else if ( val_str == "0" || val_str == "off" || val_str == "no" || val_str == "false" )
+    {
+        return false;
+    }
+
+    ISILON_LOG( "\t\t\t%s: non-convertable value \"%s\", defaulting to %s",
+                key.c_str(), val_str.c_str(), default_val ? "on" : "off");
+
+    return default_val;
+}
+
+/**
+ * Extract a numerical value from iRODS property map. Values out of
+ * [min_val, max_val] range are clamped
+ */
+ISILON_LOCAL long isilonParseNumProp( irods::plugin_property_map& prop_map,
+                                      const std::string& key,
+                                      long min_val,
+                                      long max_val,
+                                      long default_val)
+{
+    std::string val_str;
+    irods::error local_res = prop_map.get<std::string>( key, val_str);
+
+    if ( !local_res.ok() )
+    {
+        return default_val;
+    }
+
+    /* low-level "strtol" is used here because of low-level exception
+       handling in iRODS */
+    errno = 0;
+
+    char *reminder = 0;
+    long val = strtol( val_str.c_str(), &reminder, 10);
+
+    if ( errno || (reminder == val_str.c_str()) || (*reminder != '\0') )
+    {
+        ISILON_LOG( "\t\t\t%s: non-convertable value \"%s\", defaulting to %ld",
+                    key.c_str(), val_str.c_str(), default_val);
+
+        return default_val;
+    }
+
+    if ( val < min_val )
+    {
+        ISILON_LOG( "\t\t\t%s cannot be less than %ld. Using %ld",
+                    key.c_str(), min_val, min_val);
+        val = min_val;
+    } else if ( val > max_val )
+    {
+        ISILON_LOG( "\t\t\t%s cannot be bigger than %ld. Using %ld",
+                    key.c_str(), max_val, max_val);
+        val = max_val;
+    }
+
+    return val;
+}
+
+/**
+ * Extract I/O tuning parameters from iRODS property map
+ *
+ * Just like connection properties, the parameters cannot be rejected
+ * at resource construction step. Default values are used instead of
+ * invalid ones
+ */
+ISILON_LOCAL irods::error isilonParseIOParams( irods::plugin_property_map& prop_map,
+                                               isilonIOParams *io_params)
+{
+    irods::error result = SUCCESS();
+
+    ISILON_LOG( "\t\tParsing I/O parameters...");
+
+    std::string mode_str;
+
+    io_params->read_mode = ISILON_READ_SEQUENTIAL;
+
+    if ( prop_map.get<std::string>( ISILON_READ_MODE_KEY, mode_str).ok() )
+    {
+        if ( mode_str == "random" )
+        {
+            io_params->read_mode = ISILON_READ_RANDOM;
+        } else if ( mode_str != "sequential" )
+        {
+            ISILON_LOG( "\t\t\tRead mode: unknown value \"%s\", defaulting to sequential",
+                        mode_str.c_str());
+        }
+    }
+
+    ISILON_LOG( "\t\t\tRead mode: %s",
+                io_params->read_mode == ISILON_READ_RANDOM ? "random" : "sequential");
+    io_params->read_ahead = isilonParseFlagProp( prop_map, ISILON_READ_AHEAD_KEY, false);
+    ISILON_LOG( "\t\t\tRead-ahead: %s", io_params->read_ahead ? "on" : "off");
+    io_params->read_threads = isilonParseNumProp( prop_map, ISILON_READ_THREADS_KEY,
+                                                  1, ISILON_MAX_READ_THREADS,
+                                                  ISILON_DEFAULT_READ_THREADS);
+    ISILON_LOG( "\t\t\tRead threads: %d", io_params->read_threads);
+    io_params->block_cache_size = isilonParseNumProp( prop_map, ISILON_BLOCK_CACHE_KEY,
+                                                      0, ISILON_MAX_BLOCK_CACHE_SIZE,
+                                                      ISILON_DEFAULT_BLOCK_CACHE_SIZE);
+    ISILON_LOG( "\t\t\tBlock cache size: %d Mb", io_params->block_cache_size);
+    io_params->read_history = isilonParseNumProp( prop_map, ISILON_READ_HISTORY_KEY,
+                                                  0, ISILON_MAX_READ_HISTORY,
+                                                  ISILON_DEFAULT_READ_HISTORY);
+    ISILON_LOG( "\t\t\tRead history: %d Kb", io_params->read_history);
+    io_params->verify_checksums = isilonParseFlagProp( prop_map, ISILON_VERIFY_CHECKSUMS_KEY, false);
+    ISILON_LOG( "\t\t\tChecksum verification: %s", io_params->verify_checksums ? "on" : "off");
+    io_params->hedged_reads = isilonParseFlagProp( prop_map, ISILON_HEDGED_READS_KEY, false);
+    io_params->hedge_percentile = isilonParseNumProp( prop_map, ISILON_HEDGE_PERCENTILE_KEY,
+                                                      50, 99, ISILON_DEFAULT_HEDGE_PERCENTILE);
+    ISILON_LOG( "\t\t\tHedged reads: %s (after %d percentile)",
+                io_params->hedged_reads ? "on" : "off", io_params->hedge_percentile);
+    io_params->eager_read_size = isilonParseNumProp( prop_map, ISILON_EAGER_READ_SIZE_KEY,
+                                                     0, ISILON_MAX_EAGER_READ_SIZE,
+                                                     ISILON_DEFAULT_EAGER_READ_SIZE);
+    ISILON_LOG( "\t\t\tEager read size: %d Kb", io_params->eager_read_size);
+    io_params->align_fills = isilonParseFlagProp( prop_map, ISILON_ALIGN_FILLS_KEY, false);
+    ISILON_LOG( "\t\t\tBlock-aligned fills: %s", io_params->align_fills ? "on" : "off");
+    io_params->prefetch_files = isilonParseNumProp( prop_map, ISILON_PREFETCH_FILES_KEY,
+                                                    0, ISILON_MAX_PREFETCH_FILES,
+                                                    ISILON_DEFAULT_PREFETCH_FILES);
+    ISILON_LOG( "\t\t\tFiles prefetched: %d", io_params->prefetch_files);
+    io_params->write_cache_size = isilonParseNumProp( prop_map, ISILON_WRITE_CACHE_SIZE_KEY,
+                                                      0, ISILON_MAX_WRITE_CACHE_SIZE, 0);
+    ISILON_LOG( "\t\t\tWrite cache size: %d Mb", io_params->write_cache_size);
+    io_params->write_buffers = isilonParseNumProp( prop_map, ISILON_WRITE_BUFFERS_KEY,
+                                                   1, ISILON_MAX_WRITE_BUFFERS, 1);
+    ISILON_LOG( "\t\t\tWrite buffers: %d", io_params->write_buffers);
+    io_params->add_block_ahead = isilonParseFlagProp( prop_map, ISILON_ADD_BLOCK_AHEAD_KEY, false);
+    ISILON_LOG( "\t\t\tBlocks added ahead: %s", io_params->add_block_ahead ? "on" : "off");
+    io_params->write_buf_size = isilonParseNumProp( prop_map, ISILON_WRITE_BUF_SIZE_KEY,
+                                                    0, ISILON_MAX_WRITE_BUF_SIZE, 0);
+    ISILON_LOG( "\t\t\tWrite buffer size: %d Mb", io_params->write_buf_size);
+
+    return result;
+}
+
 /**
  * Get connection descriptor
  *
@@ -448,22 +649,28 @@ ISILON_LOCAL irods::error isilonGetConnection( irods::plugin_property_map& prop_
     ISILON_LOG( "\t\tPort: %lu", port_num);
     ISILON_LOG( "\t\tBuffer size: %lu", buff_size);
 
-    /* We convert here numerical port back to string and don't use original string
-       representation, because several original string representations may
-       correspond to the same integer number */
-    std::stringstream ss;
-    std::string port_name;
-    std::string bufsize_name;
-
-    ss << port_num;
-    ss >> port_name;
-    ss << buff_size;
-    ss >> bufsize_name;
-
-    /* Calculation here should be absolutely equal to calculation inside
-       "isilonGetConnectionKey". It's not good to have two different places for
-       the same calculation. Should be moved to a separate function when becomes a burden */
-    std::string key_str = bufsize_name + host_name + port_name + user_name;
+    isilonIOParams io_params = isilonIOParams();
+
+    prop_map.get<bool>( ISILON_READ_AHEAD_KEY, io_params.read_ahead);
+    prop_map.get<int>( ISILON_READ_THREADS_KEY, io_params.read_threads);
+    prop_map.get<isilonReadMode>( ISILON_READ_MODE_KEY, io_params.read_mode);
+    prop_map.get<int>( ISILON_BLOCK_CACHE_KEY, io_params.block_cache_size);
+    prop_map.get<int>( ISILON_READ_HISTORY_KEY, io_params.read_history);
+    prop_map.get<bool>( ISILON_VERIFY_CHECKSUMS_KEY, io_params.verify_checksums);
+    prop_map.get<bool>( ISILON_HEDGED_READS_KEY, io_params.hedged_reads);
+    prop_map.get<int>( ISILON_HEDGE_PERCENTILE_KEY, io_params.hedge_percentile);
+    prop_map.get<int>( ISILON_EAGER_READ_SIZE_KEY, io_params.eager_read_size);
+    prop_map.get<bool>( ISILON_ALIGN_FILLS_KEY, io_params.align_fills);
+    prop_map.get<int>( ISILON_PREFETCH_FILES_KEY, io_params.prefetch_files);
+    prop_map.get<int>( ISILON_WRITE_CACHE_SIZE_KEY, io_params.write_cache_size);
+    prop_map.get<int>( ISILON_WRITE_BUFFERS_KEY, io_params.write_buffers);
+    prop_map.get<bool>( ISILON_ADD_BLOCK_AHEAD_KEY, io_params.add_block_ahead);
+    prop_map.get<int>( ISILON_WRITE_BUF_SIZE_KEY, io_params.write_buf_size);
+    ISILON_LOG( "\t\tRead-ahead: %s", io_params.read_ahead ? "on" : "off");
+    ISILON_LOG( "\t\tRead threads: %d", io_params.read_threads);
+
+    std::string key_str = isilonComposeConnectionKey( host_name, port_num, user_name,
+                                                      buff_size, io_params);
 
 #ifndef ISILON_NO_CACHED_CONNECTIONS
     if ( CONNECTION_DESC_MAP.find( key_str) != CONNECTION_DESC_MAP.end() )
@@ -479,6 +686,11 @@ ISILON_LOCAL irods::error isilonGetConnection( irods::plugin_property_map& prop_
 
     struct hdfs_namenode *name_node = 0;
 
+    std::stringstream ss;
+    std::string port_name;
+
+    ss << port_num;
+    ss >> port_name;
     name_node = hdfs_namenode_new( host_name.c_str(), port_name.c_str(),
                                    user_name.c_str(), HDFS_NO_KERB, &err);
     result = ISILON_ASSERT_ERROR( name_node, ISILON_ERR_NEW_NAME_NODE_FAIL, err);
@@ -511,10 +723,13 @@ ISILON_LOCAL irods::error isilonGetConnection( irods::plugin_property_map& prop_
     }
 
     *connection = new isilonConnectionDesc( host_name, port_num,
-                                            user_name, name_node, buff_size);
+                                            user_name, name_node, buff_size,
+                                            io_params);
 #ifndef ISILON_NO_CACHED_CONNECTIONS
     CONNECTION_DESC_MAP.insert( std::make_pair( key_str, *connection));
 #endif
+    BLOCK_CACHE.reserve( (unsigned long long)io_params.block_cache_size * 1024 * 1024);
+    WRITE_CACHE.reserve( (unsigned long long)io_params.write_cache_size * 1024 * 1024);
     ISILON_LOG( "\tConnection to Name Node established");
 
     return result;
@@ -572,6 +787,8 @@ ISILON_LOCAL irods::error isilonReleaseConnections()
     irods::error result = SUCCESS();
 
     ISILON_LOG( "Closing all connections...");
+    /* Prefetch uses a Name Node connection */
+    FILE_PREFETCHER.wait();
 
     auto it = CONNECTION_DESC_MAP.begin();
 
@@ -882,6 +1099,16 @@ ISILON_LOCAL irods::error isilonReaddir( int num,
     return result;
 }
 
+/**
+ * Drop data of file 'path' kept by the plugin, since the file is
+ * going to be changed
+ */
+ISILON_LOCAL void isilonForgetFileData( const std::string& path)
+{
+    FILE_PREFETCHER.forget( path);
+    WRITE_CACHE.forget( path);
+}
+
 /**
  * Unlink HDFS object
  */
@@ -909,6 +1136,7 @@ ISILON_LOCAL irods::error isilonUnlinkHDFSObj( irods::resource_plugin_context& _
        recursive deletion capability of HDFS */
     /* Should we check return status of "hdfs_delete"? Can it be
        "false"? */
+    isilonForgetFileData( path);
     hdfs_delete( nn, path, false/*recurse*/, &exception);
     result = ISILON_ASSERT_ERROR( !exception, ISILON_ERR_UNLINK_FAIL,
                                   exception ? hdfs_exception_get_message( exception) : 0);
@@ -932,595 +1160,1897 @@ ISILON_LOCAL irods::error isilonUnlinkHDFSObj( irods::resource_plugin_context& _
 }
 
 /**
- * Commit a new block to a Data Node
+ * Get address ("host:port") of location 'num' of 'block'
  */
-ISILON_LOCAL irods::error isilonCommitBufferToHDFS( struct hdfs_namenode *nn,
-                                                    const char *path,
-                                                    const char *buf,
-                                                    int len,
-                                                    struct hdfs_object *last_block,
-                                                    int *status)
+ISILON_LOCAL std::string isilonGetDataNodeAddr( struct hdfs_object *block,
+                                                int num)
 {
-    irods::error result = SUCCESS();
-    struct hdfs_object *exception = 0, *block = 0;
+    struct hdfs_datanode_info *dni = &block->ob_val._located_block._locs[num]->ob_val._datanode_info;
 
-    *status = 0;
+    return std::string( dni->_hostname) + ":" + dni->_port;
+}
 
-    if ( last_block )
-    {
-        block = last_block;
-        ISILON_LOG( "\t\t\tUsing last block from HDFS");
-    } else
+/**
+ * Get the order in which locations of 'block' should be tried
+ *
+ * Locations are tried in the order given by Name Node. If 'by_score' is set
+ * and the first of them has recently been notably slower than another one,
+ * locations are ordered by their Data Node statistics instead. Then nodes
+ * with no recent statistics go first, so that they get measured.
+ * Data Nodes listed in 'excluded' are tried last in any case
+ */
+ISILON_LOCAL std::vector<int> isilonGetLocOrder( struct hdfs_object *block,
+                                                 bool by_score,
+                                                 const std::vector<std::string>& excluded)
+{
+    std::vector<int> order;
+    std::vector<double> scores;
+    double best = -1;
+
+    for ( int i = 0; i < block->ob_val._located_block._num_locs; i++ )
     {
-        block = hdfs_addBlock( nn, path, HDFS_CLIENT, 0, &exception);
-        result = ISILON_ASSERT_ERROR( !exception, ISILON_ERR_ADD_BLOCK_FAIL,
-                                      exception ? hdfs_exception_get_message( exception) : 0);
+        order.push_back( i);
+    }
 
-        if ( !result.ok() )
+    if ( by_score && order.size() > 1 )
+    {
+        for ( size_t i = 0; i < order.size(); i++ )
         {
-            isilonGetErrCodeFromException( exception, status);
-            isilonFreeHDFSObjs( 2, &exception, &block);
+            scores.push_back( NODE_STATS.score( isilonGetDataNodeAddr( block, i)));
 
-            return result;
+            if ( scores[i] >= 0 && (best < 0 || scores[i] < best) )
+            {
+                best = scores[i];
+            }
         }
 
-        ISILON_LOG( "\t\t\tBlock successfully added");
+        if ( scores[0] >= 0 && scores[0] > best * ISILON_NODE_SCORE_TOLERANCE
+             && scores[0] - best > ISILON_NODE_SCORE_MIN_DIFF )
+        {
+            std::stable_sort( order.begin(), order.end(),
+                              [&scores]( int a, int b) { return scores[a] < scores[b]; });
+            ISILON_LOG( "\t\t\t\tData Node %s (%.3f s/MB) is avoided for block %lld",
+                        isilonGetDataNodeAddr( block, 0).c_str(), scores[0],
+                        (long long)block->ob_val._located_block._blockid);
+        }
     }
 
-    struct hdfs_datanode *data_node = 0;
+    if ( !excluded.empty() )
+    {
+        std::stable_partition( order.begin(), order.end(),
+                               [block, &excluded]( int i)
+                               {
+                                   return std::find( excluded.begin(), excluded.end(),
+                                                     isilonGetDataNodeAddr( block, i)) == excluded.end();
+                               });
+    }
+
+    return order;
+}
+
+/**
+ * Connect to a Data Node holding 'block'
+ *
+ * Block locations are tried in 'order'. Each transfer takes a new
+ * connection, since a Data Node serves a single operation per
+ * connection. 'addr' receives the address of the Data Node
+ */
+ISILON_LOCAL irods::error isilonConnectToDataNode( struct hdfs_object *block,
+                                                   const std::vector<int>& order,
+                                                   struct hdfs_datanode *dn,
+                                                   std::string *addr)
+{
+    irods::error result = SUCCESS();
+    struct hdfs_located_block *lb = &block->ob_val._located_block;
+    struct hdfs_datanode_info *dni = 0;
     const char *err = 0;
 
-    data_node = hdfs_datanode_new( block, HDFS_CLIENT, HDFS_DATANODE_AP_1_0, &err);
-    result = ISILON_ASSERT_ERROR( data_node, ISILON_ERR_CONNECT_TO_DATANODE_FAIL, err,
-                                  block->ob_val._located_block._locs[0]->ob_val._datanode_info._hostname,
-                                  block->ob_val._located_block._locs[0]->ob_val._datanode_info._port);
+    result = ISILON_ASSERT_ERROR( !order.empty(), ISILON_ERR_CORRUPTED_OR_INCORRECT_BLOCK,
+                                  (long long)lb->_offset, (long long)lb->_len);
+    ISILON_ERROR_CHECK( result);
 
-    if ( !result.ok() )
+    hdfs_datanode_init( dn, lb->_blockid, lb->_len, lb->_generation, lb->_offset,
+                        HDFS_CLIENT, lb->_token, HDFS_DATANODE_AP_1_0);
+
+    for ( size_t i = 0; i < order.size(); i++ )
     {
-        isilonFreeHDFSObjs( 2, &exception, &block);
-        *status = EIO;
+        dni = &lb->_locs[order[i]]->ob_val._datanode_info;
+        *addr = isilonGetDataNodeAddr( block, order[i]);
+        err = hdfs_datanode_connect( dn, dni->_hostname, dni->_port);
 
-        return result;
-    }
+        if ( !err )
+        {
+            ISILON_LOG( "\t\t\t\tConnected to Data Node %s", addr->c_str());
 
-    ISILON_LOG( "\t\t\tData Node acquired: %s",
-                 block->ob_val._located_block._locs[0]->ob_val._datanode_info._hostname);
-    err = hdfs_datanode_write( data_node, buf, len, false/*crcs*/);
-    result = ISILON_ASSERT_ERROR( !err, ISILON_ERR_WRITE_FAIL, err);
-    hdfs_datanode_delete( data_node);
-    isilonFreeHDFSObjs( 2, &exception, &block);
+            return result;
+        }
 
-    if ( !result.ok() )
-    {
-        *status = EIO;
-        
-        return result;
+        NODE_STATS.addFailure( *addr);
     }
 
-    ISILON_LOG( "\t\t\t%d bytes written", len);
+    result = ISILON_ASSERT_ERROR( !err, ISILON_ERR_CONNECT_TO_DATANODE_FAIL, err,
+                                  dni->_hostname, dni->_port);
+    hdfs_datanode_destroy( dn);
 
     return result;
 }
 
 /**
- * Low-level part of "append" processing
+ * Read 'len' bytes from 'block' starting at 'block_offset', trying block
+ * locations in 'order'. Checksums sent by the Data Node are verified
+ * by Hadoofus if 'verify' is set
+ *
+ * If the read is an attempt 'num' of hedged read 'hr', it can be
+ * cancelled from another thread. Every transfer is accounted
+ * in Data Node statistics. 'addr' receives the address of the Data Node
+ * read from
  */
-ISILON_LOCAL irods::error isilonAppendFileImpl( isilonConnectionDesc *conn,
-                                                const char           *path,
-                                                struct hdfs_object   **last_block,
-                                                int                  *status)
+ISILON_LOCAL irods::error isilonReadBlockFrom( struct hdfs_object *block,
+                                              const std::vector<int>& order,
+                                              int64_t block_offset,
+                                              int64_t len,
+                                              char *buf,
+                                              bool verify,
+                                              isilonHedgedRead *hr,
+                                              int num,
+                                              std::string *addr)
 {
     irods::error result = SUCCESS();
-    struct hdfs_object *exception = 0, *lb = 0;
+    struct hdfs_datanode dn;
+    const char *err = 0;
+    double start = 0;
 
-    ISILON_LOG( "\tOpening file for append");
-    ISILON_LOG( "\t\tPath: %s", path);    
-    lb = hdfs_append( conn->getNameNode(), path, HDFS_CLIENT, &exception);
-    result = ISILON_ASSERT_ERROR( !exception, ISILON_ERR_CREATE_FILE_FAIL,
-                                  exception ? hdfs_exception_get_message( exception) : 0);
+    result = isilonConnectToDataNode( block, order, &dn, addr);
+    ISILON_ERROR_CHECK_PASS( result);
 
-    if ( !result.ok() )
+    if ( hr && !hr->attach( num, dn.dn_sock) )
     {
-        isilonGetErrCodeFromException( exception, status);
-        isilonFreeHDFSObjs( 1, &exception);
+        hdfs_datanode_destroy( &dn);
+        result = ISILON_ASSERT_ERROR( false, ISILON_ERR_READ_FAIL, "hedged read cancelled");
 
         return result;
     }
 
-    ISILON_LOG( "\t\tAppend successful");
-    isilonFreeHDFSObjs( 1, &exception);
+    start = isilonGetTime();
+    err = hdfs_datanode_read( &dn, block_offset, len, buf, verify);
 
-    if ( (lb && lb->ob_type == H_NULL)
-         || !lb->ob_val._located_block._len )
+    if ( hr )
     {
-        hdfs_object_free( lb);
-        lb = 0;
+        hr->detach( num);
     }
 
-    *last_block = lb;
+    hdfs_datanode_destroy( &dn);
+
+    if ( !err || (hr && hr->isCancelled( num)) )
+    {
+        /* A cancelled read lost to another node, so the time
+           it took is still a (lower) estimate of the node's speed */
+        NODE_STATS.add( *addr, isilonGetTime() - start, len);
+    } else
+    {
+        NODE_STATS.addFailure( *addr);
+    }
+
+    result = ISILON_ASSERT_ERROR( !err, ISILON_ERR_READ_FAIL, err);
 
     return result;
 }
 
 /**
- * Open file in "append" mode
+ * Body of a thread performing the second attempt of a hedged read
  */
-ISILON_LOCAL irods::error isilonAppendFile( isilonConnectionDesc *conn,
-                                            const char           *path,
-                                            int                  *file_id,
-                                            int                  *status)
+ISILON_LOCAL void isilonHedgeWorker( isilonHedgeJob *job)
 {
     irods::error result = SUCCESS();
-    /* check incoming parameters */
-    bool check_expr = conn && path && status && file_id;
 
-    result = ISILON_ASSERT_ERROR( check_expr, ISILON_ERR_NULL_ARGS);
-    ISILON_ERROR_CHECK( result);
-    *status = 0;
+    ISILON_LOG( "\t\t\t\tRead of block %lld is slow. Hedging",
+                (long long)job->block->ob_val._located_block._blockid);
+    job->buf = (char *)malloc( job->len);
+    result = ISILON_ASSERT_ERROR( job->buf, ISILON_ERR_READ_FAIL, "no memory for hedged read");
 
-    struct hdfs_object *last_block = 0;
+    if ( result.ok() )
+    {
+        result = isilonReadBlockFrom( job->block, job->order, job->block_offset, job->len,
+                                      job->buf, job->verify, job->hr, 1, &job->addr);
+    }
 
-    result = isilonAppendFileImpl( conn, path, &last_block, status);
-    ISILON_ERROR_CHECK_PASS( result);
+    /* The first attempt is not needed any more */
+    if ( result.ok() )
+    {
+        job->hr->cancel( 0);
+    }
 
-    /* Write mode is implied for append */
-    *file_id = isilonNewFileDesc( ISILON_MODE_WRITE, path, conn->getBuffSize(),
-                                  last_block);
- 
-    return result;
+    job->hr->complete( 1, result);
 }
 
 /**
- * Create new file and open new file descriptor
+ * Read data of a block from its first location and, if the read takes
+ * longer than 'timeout' seconds, from another location as well
+ *
+ * The first attempt is made by the current thread. A thread for the
+ * second one is started by the hedger only when the timeout expires.
+ * The first read to succeed wins. 'addr' receives the address of the
+ * Data Node which result is returned
  */
-ISILON_LOCAL irods::error isilonCreateFile( isilonConnectionDesc *conn,
-                                            const char           *path,
-                                            int                  mode,
-                                            bool                 overwrite,
-                                            int                  *file_id,
-                                            int                  *status)
+ISILON_LOCAL irods::error isilonHedgedReadBlock( struct hdfs_object *block,
+                                                const std::vector<int>& order,
+                                                int64_t block_offset,
+                                                int64_t len,
+                                                char *buf,
+                                                bool verify,
+                                                double timeout,
+                                                std::string *addr)
 {
     irods::error result = SUCCESS();
-    /* check incoming parameters */
-    bool check_expr = conn && path && status && file_id;
-
-    result = ISILON_ASSERT_ERROR( check_expr, ISILON_ERR_NULL_ARGS);
-    ISILON_ERROR_CHECK( result);
+    isilonHedgedRead hr;
+    isilonHedgeJob job;
+
+    job.hr = &hr;
+    job.block = block;
+    job.order.assign( order.begin() + 1, order.end());
+    job.order.push_back( order[0]);
+    job.block_offset = block_offset;
+    job.len = len;
+    job.verify = verify;
+    job.due = boost::get_system_time() + boost::posix_time::microseconds( (long long)(timeout * 1e6));
+    job.worker = isilonHedgeWorker;
+    HEDGER.arm( &job);
+    result = isilonReadBlockFrom( block, order, block_offset, len, buf, verify, &hr, 0, addr);
+
+    if ( HEDGER.disarm( &job) )
+    {
+        return result;
+    }
 
-    struct hdfs_namenode *nn = conn->getNameNode();
-    struct hdfs_object *exception = 0;
+    if ( result.ok() )
+    {
+        hr.cancel( 1);
+    }
 
-    *status = 0;
-    ISILON_LOG( "\tFile creation requested");
-    ISILON_LOG( "\t\tPath: %s", path);
-    ISILON_LOG( "\t\tMode: 0x%x", mode);
-    hdfs_create( nn, path, mode,
-                 HDFS_CLIENT, overwrite, true/*createparent*/,
-                 1/*replication*/, 4*1024*1024, &exception);
-    result = ISILON_ASSERT_ERROR( !exception, ISILON_ERR_CREATE_FILE_FAIL,
-                                  exception ? hdfs_exception_get_message( exception) : 0);
+    job.thread.join();
 
-    if ( !result.ok() )
+    if ( !result.ok() && hr.getResult( 1).ok() )
     {
-        isilonGetErrCodeFromException( exception, status);
-        isilonFreeHDFSObjs( 1, &exception);
-
-        return result;
+        ISILON_LOG( "\t\t\t\tHedged read of block %lld won",
+                    (long long)block->ob_val._located_block._blockid);
+        memcpy( buf, job.buf, len);
+        *addr = job.addr;
+        result = hr.getResult( 1);
     }
 
-    /* Write mode is implied for creation */
-    *file_id = isilonNewFileDesc( ISILON_MODE_WRITE, path, conn->getBuffSize(), 0);
-    isilonFreeHDFSObjs( 1, &exception);
- 
+    free( job.buf);
+
     return result;
 }
 
 /**
- * Close opened file, flush its buffer and release file decriptor
+ * Read 'len' bytes from 'block' starting at 'block_offset'
+ *
+ * Data is read with a single request, or in segments of a fraction of
+ * the block length if 'segmented' is set. After a failure 'done' tells
+ * how many bytes have been read and 'addr' which Data Node failed. Data
+ * Nodes in 'excluded' are tried last.
+ * With hedged reads on, a read which takes longer than most recent reads
+ * of the same size is duplicated to another block location
  */
-ISILON_LOCAL irods::error isilonCloseFile( class isilonConnectionDesc *conn,
-                                           int                        file_id,
-                                           int                        *status)
+ISILON_LOCAL irods::error isilonReadBlock( struct hdfs_object *block,
+                                          int64_t block_offset,
+                                          int64_t len,
+                                          char *buf,
+                                          const isilonIOParams& io_params,
+                                          const std::vector<std::string>& excluded,
+                                          bool segmented,
+                                          int64_t *done,
+                                          std::string *addr)
 {
     irods::error result = SUCCESS();
-    /* check incoming parameters */
-    bool check_expr = conn && status;
+    std::vector<int> order = isilonGetLocOrder( block, true, excluded);
+    int64_t seg_size = len;
 
-    result = ISILON_ASSERT_ERROR( check_expr, ISILON_ERR_NULL_ARGS);
-    ISILON_ERROR_CHECK( result);
-    *status = 0;
+    if ( segmented )
+    {
+        seg_size = std::max( block->ob_val._located_block._len / ISILON_READ_SEGMENTS_PER_BLOCK,
+                             (int64_t)ISILON_MIN_READ_SEGMENT_SIZE);
+    }
+
+    *done = 0;
+
+    while ( *done < len )
+    {
+        int64_t seg_len = std::min( len - *done, seg_size);
+        double timeout = -1;
+        double start = isilonGetTime();
+
+        if ( io_params.hedged_reads && order.size() > 1 )
+        {
+            timeout = READ_LATENCY.percentile( io_params.hedge_percentile, seg_len);
+        }
+
+        if ( timeout < 0 )
+        {
+            result = isilonReadBlockFrom( block, order, block_offset + *done, seg_len,
+                                          buf + *done, io_params.verify_checksums, 0, 0, addr);
+        } else
+        {
+            result = isilonHedgedReadBlock( block, order, block_offset + *done, seg_len,
+                                            buf + *done, io_params.verify_checksums,
+                                            timeout, addr);
+        }
+
+        ISILON_ERROR_CHECK_PASS( result);
+        READ_LATENCY.add( isilonGetTime() - start, seg_len);
+        *done += seg_len;
+    }
+
+    return result;
+}
+
+/**
+ * Write 'len' bytes to 'block'
+ *
+ * A block write cannot be repeated once its data may have been sent,
+ * since the Data Node may keep a partial replica of the block. Locations
+ * are kept in Name Node order, since they form the write pipeline
+ */
+ISILON_LOCAL irods::error isilonWriteBlock( struct hdfs_object *block,
+                                           const char *buf,
+                                           int len)
+{
+    irods::error result = SUCCESS();
+    struct hdfs_datanode dn;
+    std::string addr;
+    const char *err = 0;
+    double start = 0;
+
+    result = isilonConnectToDataNode( block,
+                                      isilonGetLocOrder( block, false, std::vector<std::string>()),
+                                      &dn, &addr);
+    ISILON_ERROR_CHECK_PASS( result);
+
+    start = isilonGetTime();
+    err = hdfs_datanode_write( &dn, buf, len, false/*crcs*/);
+    hdfs_datanode_destroy( &dn);
+
+    if ( !err )
+    {
+        NODE_STATS.add( addr, isilonGetTime() - start, len);
+    } else
+    {
+        NODE_STATS.addFailure( addr);
+    }
+
+    result = ISILON_ASSERT_ERROR( !err, ISILON_ERR_WRITE_FAIL, err);
+
+    return result;
+}
+
+/**
+ * Add a new block to a file being written in background
+ */
+ISILON_LOCAL void isilonAddBlockWorker( struct hdfs_namenode *nn,
+                                        std::string path,
+                                        isilonNextBlock *next_block)
+{
+    struct hdfs_object *exception = 0;
+    struct hdfs_object *block = hdfs_addBlock( nn, path.c_str(), HDFS_CLIENT, 0, &exception);
+
+    next_block->set( block, exception);
+}
+
+/**
+ * Abandon the block added in advance, if it is left unused
+ */
+ISILON_LOCAL irods::error isilonAbandonNextBlock( struct hdfs_namenode *nn,
+                                                  const char *path,
+                                                  isilonNextBlock *next_block,
+                                                  int *status)
+{
+    irods::error result = SUCCESS();
+    struct hdfs_object *exception = 0, *block = 0;
+
+    if ( !next_block->take( &block, &exception) )
+    {
+        return result;
+    }
+
+    /* The block was not added, so there is nothing to abandon */
+    if ( exception )
+    {
+        isilonFreeHDFSObjs( 2, &exception, &block);
+
+        return result;
+    }
+
+    struct hdfs_object *bl = hdfs_block_from_located_block( block);
+
+    hdfs_abandonBlock( nn, bl, path, HDFS_CLIENT, &exception);
+    result = ISILON_ASSERT_ERROR( !exception, ISILON_ERR_ABANDON_BLOCK_FAIL,
+                                  exception ? hdfs_exception_get_message( exception) : 0);
+
+    if ( !result.ok() )
+    {
+        isilonGetErrCodeFromException( exception, status);
+    } else
+    {
+        ISILON_LOG( "\t\tBlock added in advance is abandoned");
+    }
+
+    isilonFreeHDFSObjs( 3, &exception, &block, &bl);
+
+    return result;
+}
+
+/**
+ * Commit a new block to a Data Node
+ *
+ * A block added in advance is used, if 'next_block' holds one. If
+ * 'request_next' is set, the block for the next commit is requested
+ * while this one is written
+ */
+ISILON_LOCAL irods::error isilonCommitBufferToHDFS( struct hdfs_namenode *nn,
+                                                    const char *path,
+                                                    const char *buf,
+                                                    int len,
+                                                    struct hdfs_object *last_block,
+                                                    isilonNextBlock *next_block,
+                                                    bool request_next,
+                                                    int *status)
+{
+    irods::error result = SUCCESS();
+    struct hdfs_object *exception = 0, *block = 0;
+
+    *status = 0;
+
+    if ( last_block )
+    {
+        block = last_block;
+        ISILON_LOG( "\t\t\tUsing last block from HDFS");
+    } else
+    {
+        if ( next_block->take( &block, &exception) )
+        {
+            ISILON_LOG( "\t\t\tUsing block added in advance");
+        } else
+        {
+            block = hdfs_addBlock( nn, path, HDFS_CLIENT, 0, &exception);
+        }
+
+        result = ISILON_ASSERT_ERROR( !exception, ISILON_ERR_ADD_BLOCK_FAIL,
+                                      exception ? hdfs_exception_get_message( exception) : 0);
+
+        if ( !result.ok() )
+        {
+            isilonGetErrCodeFromException( exception, status);
+            isilonFreeHDFSObjs( 2, &exception, &block);
+
+            return result;
+        }
+
+        ISILON_LOG( "\t\t\tBlock successfully added");
+    }
+
+    if ( request_next )
+    {
+        next_block->request( isilonAddBlockWorker, nn, std::string( path), next_block);
+    }
+
+    result = isilonWriteBlock( block, buf, len);
+    isilonFreeHDFSObjs( 2, &exception, &block);
+
+    if ( !result.ok() )
+    {
+        *status = EIO;
+        
+        return result;
+    }
+
+    ISILON_LOG( "\t\t\t%d bytes written", len);
+
+    return result;
+}
+
+/**
+ * Commit buffers queued by a file written with several buffers
+ */
+ISILON_LOCAL void isilonWriteBehindWorker( struct hdfs_namenode *nn,
+                                           std::string path,
+                                           isilonWriteQueue *queue,
+                                           isilonNextBlock *next_block)
+{
+    isilonWriteJob job;
+
+    while ( queue->take( &job) )
+    {
+        int status = 0;
+        irods::error result = isilonCommitBufferToHDFS( nn, path.c_str(), job.buff,
+                                                        job.len, 0, next_block,
+                                                        true, &status);
+
+        queue->complete( job, result, status);
+    }
+}
+
+/**
+ * Size of write buffers of a file opened for writing
+ */
+ISILON_LOCAL unsigned long isilonGetWriteBuffSize( isilonConnectionDesc *conn,
+                                                   struct hdfs_object   *last_block)
+{
+    unsigned long buff_size = (unsigned long)conn->getIOParams().write_buf_size * 1024 * 1024;
+
+    /* The first buffer of an appended file fills its last block up to
+       the buffer size, so the buffer should be bigger than the block */
+    if ( !buff_size
+         || (last_block && (long long)buff_size <= last_block->ob_val._located_block._len) )
+    {
+        buff_size = conn->getBuffSize();
+    }
+
+    return buff_size;
+}
+
+/**
+ * Let a file opened for writing commit its full buffers in background
+ * and add blocks in advance, as the resource is configured
+ */
+ISILON_LOCAL void isilonSetupFileWrite( isilonConnectionDesc *conn,
+                                        int                  file_id)
+{
+#ifdef ISILON_NO_CACHED_CONNECTIONS
+    /* Name Node connection is closed at the end of each plugin operation
+       in this mode, so it cannot be used by a background thread */
+    return;
+#endif
+
+    const isilonIOParams& io_params = conn->getIOParams();
+    isilonFileDesc *fd = 0;
+
+    isilonGetFileDescByID( file_id, &fd);
+
+    if ( io_params.write_buffers > 1 )
+    {
+        fd->setWriteQueue( isilonWriteQueuePtr( new isilonWriteQueue( io_params.write_buffers)));
+    }
+
+    if ( io_params.add_block_ahead )
+    {
+        fd->getNextBlock()->enable();
+    }
+}
+
+/**
+ * Low-level part of "append" processing
+ */
+ISILON_LOCAL irods::error isilonAppendFileImpl( isilonConnectionDesc *conn,
+                                                const char           *path,
+                                                struct hdfs_object   **last_block,
+                                                int                  *status)
+{
+    irods::error result = SUCCESS();
+    struct hdfs_object *exception = 0, *lb = 0;
+
+    ISILON_LOG( "\tOpening file for append");
+    ISILON_LOG( "\t\tPath: %s", path);    
+    isilonForgetFileData( path);
+    lb = hdfs_append( conn->getNameNode(), path, HDFS_CLIENT, &exception);
+    result = ISILON_ASSERT_ERROR( !exception, ISILON_ERR_CREATE_FILE_FAIL,
+                                  exception ? hdfs_exception_get_message( exception) : 0);
+
+    if ( !result.ok() )
+    {
+        isilonGetErrCodeFromException( exception, status);
+        isilonFreeHDFSObjs( 1, &exception);
+
+        return result;
+    }
+
+    ISILON_LOG( "\t\tAppend successful");
+    isilonFreeHDFSObjs( 1, &exception);
+
+    if ( (lb && lb->ob_type == H_NULL)
+         || !lb->ob_val._located_block._len )
+    {
+        hdfs_object_free( lb);
+        lb = 0;
+    }
+
+    *last_block = lb;
+
+    return result;
+}
+
+/**
+ * Open file in "append" mode
+ */
+ISILON_LOCAL irods::error isilonAppendFile( isilonConnectionDesc *conn,
+                                            const char           *path,
+                                            int                  *file_id,
+                                            int                  *status)
+{
+    irods::error result = SUCCESS();
+    /* check incoming parameters */
+    bool check_expr = conn && path && status && file_id;
+
+    result = ISILON_ASSERT_ERROR( check_expr, ISILON_ERR_NULL_ARGS);
+    ISILON_ERROR_CHECK( result);
+    *status = 0;
+
+    struct hdfs_object *last_block = 0;
+
+    result = isilonAppendFileImpl( conn, path, &last_block, status);
+    ISILON_ERROR_CHECK_PASS( result);
+
+    /* Write mode is implied for append */
+    *file_id = isilonNewFileDesc( ISILON_MODE_WRITE, path,
+                                  isilonGetWriteBuffSize( conn, last_block), last_block);
+    isilonSetupFileWrite( conn, *file_id);
+ 
+    return result;
+}
+
+/**
+ * Create new file and open new file descriptor
+ */
+ISILON_LOCAL irods::error isilonCreateFile( isilonConnectionDesc *conn,
+                                            const char           *path,
+                                            int                  mode,
+                                            bool                 overwrite,
+                                            int                  *file_id,
+                                            int                  *status)
+{
+    irods::error result = SUCCESS();
+    /* check incoming parameters */
+    bool check_expr = conn && path && status && file_id;
+
+    result = ISILON_ASSERT_ERROR( check_expr, ISILON_ERR_NULL_ARGS);
+    ISILON_ERROR_CHECK( result);
+
+    struct hdfs_namenode *nn = conn->getNameNode();
+    struct hdfs_object *exception = 0;
+
+    *status = 0;
+    ISILON_LOG( "\tFile creation requested");
+    ISILON_LOG( "\t\tPath: %s", path);
+    ISILON_LOG( "\t\tMode: 0x%x", mode);
+    isilonForgetFileData( path);
+    hdfs_create( nn, path, mode,
+                 HDFS_CLIENT, overwrite, true/*createparent*/,
+                 1/*replication*/, ISILON_BLOCK_SIZE, &exception);
+    result = ISILON_ASSERT_ERROR( !exception, ISILON_ERR_CREATE_FILE_FAIL,
+                                  exception ? hdfs_exception_get_message( exception) : 0);
+
+    if ( !result.ok() )
+    {
+        isilonGetErrCodeFromException( exception, status);
+        isilonFreeHDFSObjs( 1, &exception);
+
+        return result;
+    }
+
+    /* Write mode is implied for creation */
+    *file_id = isilonNewFileDesc( ISILON_MODE_WRITE, path, isilonGetWriteBuffSize( conn, 0), 0);
+    isilonFreeHDFSObjs( 1, &exception);
+    isilonSetupFileWrite( conn, *file_id);
+
+    /* The whole file is written through this descriptor, so the data
+       written to it can be kept for reading it back */
+    unsigned long max_len = (unsigned long)conn->getIOParams().write_cache_size * 1024 * 1024;
+
+    if ( max_len )
+    {
+        isilonFileDesc *fd = 0;
+
+        isilonGetFileDescByID( *file_id, &fd);
+        fd->setWrittenData( isilonWrittenDataPtr( new isilonWrittenData( max_len)));
+    }
+ 
+    return result;
+}
+
+/**
+ * Close opened file, flush its buffer and release file decriptor
+ */
+ISILON_LOCAL irods::error isilonCloseFile( class isilonConnectionDesc *conn,
+                                           int                        file_id,
+                                           int                        *status)
+{
+    irods::error result = SUCCESS();
+    /* check incoming parameters */
+    bool check_expr = conn && status;
+
+    result = ISILON_ASSERT_ERROR( check_expr, ISILON_ERR_NULL_ARGS);
+    ISILON_ERROR_CHECK( result);
+    *status = 0;
+
+    struct hdfs_namenode *nn = conn->getNameNode();
+    struct hdfs_object *exception = 0;
+    isilonFileDesc *fd = 0;
+    
+    result = isilonGetFileDescByID( file_id, &fd);
+    ISILON_ERROR_CHECK_PASS( result);
+
+    isilon_file_handle file_handle( file_id, isilonDestroyObjDesc);
+    isilonFileMode mode = fd->getMode();
+    const char *path = fd->getPath().c_str();
+
+    ISILON_LOG( "\tFile to close: %s (id: %d)", path, file_id);
+
+    if ( mode == ISILON_MODE_WRITE )
+    {
+        isilonWriteQueue *queue = fd->getWriteQueue();
+        /* A block added in advance is not used once the close fails,
+           so it is abandoned (ignoring the abandon status) */
+        int abandon_status = 0;
+
+        /* Buffers queued before are committed first */
+        if ( queue )
+        {
+            result = queue->getError( true, status);
+
+            if ( !result.ok() )
+            {
+                isilonAbandonNextBlock( nn, path, fd->getNextBlock(), &abandon_status);
+
+                return PASS( result);
+            }
+        }
+
+        int buff_offset = fd->getBuffOffset();
+
+        if ( buff_offset )
+        {
+            const char *buff = 0;
+
+            /* Commit block to HDFS */
+            ISILON_LOG( "\tFile buffer is not empty (%d bytes). Committing to HDFS",
+                        buff_offset);
+            result = fd->flushBuff( &buff);
+
+            if ( !result.ok() )
+            {
+                isilonAbandonNextBlock( nn, path, fd->getNextBlock(), &abandon_status);
+
+                return PASS( result);
+            }
+
+            result = isilonCommitBufferToHDFS( nn, path, buff, buff_offset,
+                                               fd->getLastBlock(), fd->getNextBlock(),
+                                               false, status);
+
+            if ( fd->getLastBlock() )
+            {
+                /* Actually may skip this, but do it for explicity */
+                fd->releaseLastBlock();
+            } 
+
+            if ( !result.ok() )
+            {
+                isilonAbandonNextBlock( nn, path, fd->getNextBlock(), &abandon_status);
+                *status = EIO;
+
+                return PASS( result);
+            }
+        }
+
+        /* The file ended right after a full buffer */
+        result = isilonAbandonNextBlock( nn, path, fd->getNextBlock(), status);
+        ISILON_ERROR_CHECK_PASS( result);
+
+        bool is_ok = hdfs_complete( nn, path, HDFS_CLIENT, &exception);
+
+        result = ISILON_ASSERT_ERROR( !exception, ISILON_ERR_COMPLETE_FAIL,
+                                      exception ? hdfs_exception_get_message( exception) : 0);
+        ISILON_LOG( "\tFile %s completed", path);
+
+        if ( !result.ok() )
+        {
+            isilonGetErrCodeFromException( exception, status);
+            isilonFreeHDFSObjs( 1, &exception);
+
+            return result;
+        }
+
+        result = ISILON_ASSERT_ERROR( is_ok, ISILON_ERR_FILE_NOT_COMPLETED,
+                                      path);
+
+        if ( !result.ok() )
+        {
+            isilonFreeHDFSObjs( 1, &exception);
+            *status = EIO;
+
+            return result;
+        }
+
+        isilonWrittenDataPtr written = fd->getWrittenData();
+
+        if ( written && written->end == fd->getFileSize() )
+        {
+            struct hdfs_object *fstat = 0;
+
+            /* The data are matched with the file by its modification time,
+               so that the file overwritten by someone else is not served */
+            if ( isilonGetHDFSFileInfo( nn, path, &fstat, 0).ok() )
+            {
+                written->mtime = fstat->ob_val._file_status._mtime;
+                ISILON_LOG( "\tLast %lu bytes written to %s are kept", written->data.size(), path);
+                WRITE_CACHE.put( fd->getPath(), written);
+            }
+
+            isilonFreeHDFSObjs( 1, &fstat);
+        }
+    } else
+    {
+        result = ISILON_ASSERT_ERROR( mode == ISILON_MODE_READ,
+                                      ISILON_ERR_MODE_NOT_SUPPORTED);
+
+        if ( !result.ok() )
+        {
+            isilonFreeHDFSObjs( 1, &exception);
+
+            return result;
+        }
+
+#ifdef ISILON_DEBUG
+        isilonAccessPattern *pattern = fd->getAccessPattern();
+
+        /* Accuracy of the access pattern detector */
+        for ( int i = 0; i < ISILON_ACCESS_CLASSES_NUM; i++ )
+        {
+            if ( pattern->getHits( i) || pattern->getMisses( i) )
+            {
+                ISILON_LOG( "\tPredictions of %s access: %lu hit(s), %lu miss(es)",
+                            isilonAccessPattern::getName( i), pattern->getHits( i),
+                            pattern->getMisses( i));
+            }
+        }
+#endif
+    }
+
+    isilonFreeHDFSObjs( 1, &exception);
+
+    return result;
+}
+
+/**
+ * Write data to a buffer and commit to HDFS Data Node (if the buffer is filled)
+ */
+ISILON_LOCAL irods::error isilonWriteBuf( struct hdfs_namenode *nn,
+                                          int id,
+                                          const char *buf,
+                                          int len,
+                                          int *status)
+{
+    irods::error result = SUCCESS();
+    /* check incoming parameters */
+    bool check_expr = nn && buf && status;
+
+    result = ISILON_ASSERT_ERROR( check_expr, ISILON_ERR_NULL_ARGS);
+    ISILON_ERROR_CHECK( result);
+
+    isilonFileDesc *fd = 0;
+
+    result = isilonGetFileDescByID( id, &fd);
+    ISILON_ERROR_CHECK_PASS( result);
+    result = ISILON_ASSERT_ERROR( fd->getMode() == ISILON_MODE_WRITE,
+                                  ISILON_ERR_UNEXPECTED_MODE, fd->getMode(),
+                                  ISILON_MODE_WRITE);
+    ISILON_ERROR_CHECK( result);
+    result = ISILON_ASSERT_ERROR( fd->getFileSize() == fd->getOffset(),
+                                  ISILON_ERR_UNEXPECTED_OFFSET, id,
+                                  fd->getFileSize(), fd->getOffset());
+    ISILON_ERROR_CHECK( result);
+
+    isilonWriteQueue *queue = fd->getWriteQueue();
+
+    /* A failed background commit fails the writes following it */
+    if ( queue )
+    {
+        result = queue->getError( false, status);
+        ISILON_ERROR_CHECK_PASS( result);
+    }
+
+    int buf_offset = 0;
+    const int total_len = len;
+    const long long start_offset = fd->getOffset();
+
+    while ( len )
+    {
+        const char *wbuff = 0;
+        int wbuff_size = fd->getBuffSize();
+        int wbuff_offset = fd->getBuffOffset();
+        int bytes_added = 0;
+        /* The last block of an appended file is filled synchronously */
+        bool write_behind = queue && !fd->getLastBlock();
+
+        /* Buffers committed in background cannot refer to the caller's data */
+        if ( len >= wbuff_size && wbuff_offset == 0 && !write_behind )
+        {
+            /* Size of data to write is bigger or equal to buffer size and
+               the buffer is currently empty. So we can skip bufferization
+               step and commit the data directly to HDFS */
+            wbuff = buf + buf_offset;
+            buf_offset += wbuff_size;
+            bytes_added = wbuff_size;
+            len -= wbuff_size;
+        } else
+        {
+            int buff_avail = wbuff_size - wbuff_offset;
+
+            if ( buff_avail > len )
+            {
+                result = fd->writeToBuff( buf, buf_offset, len);
+                ISILON_ERROR_CHECK_PASS( result);
+                buf_offset += len;
+                bytes_added = len;
+                len = 0;
+            } else
+            {
+                result = fd->writeToBuff( buf, buf_offset, buff_avail);
+                ISILON_ERROR_CHECK_PASS( result);
+                len -= buff_avail;
+                buf_offset += buff_avail;
+                bytes_added = buff_avail;
+                result = fd->flushBuff( &wbuff);
+                ISILON_ERROR_CHECK_PASS( result);
+            }
+
+            /* We use 'wbuff_offset + bytes_added' for buffer payload size
+               instead of 'fd->getBuffSize()' because the buffer might be flushed */
+            ISILON_LOG( "\t\t%d bytes bufferized. Currently in buffer: %d",
+                        bytes_added, wbuff_offset + bytes_added);
+        }
+
+        if ( wbuff && write_behind )
+        {
+            ISILON_LOG( "\t\tBuffer is full. Committing to HDFS in background");
+            queue->push( fd->detachBuff(), wbuff_size, isilonWriteBehindWorker,
+                         nn, fd->getPath(), queue, fd->getNextBlock());
+            fd->attachBuff( queue->getBuffer());
+        } else if ( wbuff )
+        {
+            /* Commit block to HDFS */
+            ISILON_LOG( "\t\tBuffer is full. Committing to HDFS");
+            result = isilonCommitBufferToHDFS( nn, fd->getPath().c_str(), wbuff,
+                                               wbuff_size, fd->getLastBlock(),
+                                               fd->getNextBlock(), true, status);
+            ISILON_ERROR_CHECK_PASS( result);
+
+            if ( fd->getLastBlock() )
+            {
+                fd->releaseLastBlock();
+            }
+        }
+
+        /* Only at this point we know that the data were placed to buffer
+           or committed directly to HDFS. Only now we can adjust the file offset */
+#ifdef ISILON_DEBUG
+        isilonSetObjOffsetByID( id, fd->getOffset() + bytes_added);
+#else
+        fd->setOffset( fd->getOffset() + bytes_added);
+#endif
+        /* After any write operation made inside this plugin, file size
+           should be equal to file offset, since only writes to the end
+           of the file are allowed */
+        fd->setFileSize( fd->getOffset());
+    }
+
+    isilonWrittenDataPtr written = fd->getWrittenData();
+
+    /* Data are not kept any more, if a write has failed before */
+    if ( written && written->end == start_offset )
+    {
+        written->append( buf, total_len);
+    }
+
+    return result;
+}
+
+/**
+ * Write data to the specified file
+ */
+ISILON_LOCAL irods::error isilonWriteFile( isilonConnectionDesc *conn,
+                                           int                  file_id,
+                                           void                 *_buf,
+                                           int                  _len,
+                                           int                  *status)
+{
+    irods::error result = SUCCESS();
+
+    /* check incoming parameters */
+    bool check_expr = conn && _buf && status;
+
+    result = ISILON_ASSERT_ERROR( check_expr, ISILON_ERR_NULL_ARGS);
+    ISILON_ERROR_CHECK( result);
+    *status = 0;
+
+    struct hdfs_namenode *nn = conn->getNameNode();
+
+#ifdef ISILON_DEBUG
+    /* Sanity check. For now current file offset should be equal to
+       file size + size of bufferized data */
+    isilonFileDesc *fd = 0;
+
+    result = isilonGetFileDescByID( file_id, &fd);
+    ISILON_ERROR_CHECK_PASS( result);
+
+    /* Size of HDFS file does not include buffers being committed
+       in background. So wait for them to be committed */
+    if ( fd->getWriteQueue() )
+    {
+        result = fd->getWriteQueue()->getError( true, status);
+        ISILON_ERROR_CHECK_PASS( result);
+    }
+
+    struct hdfs_object *fstatus = 0;
+
+    result = isilonGetHDFSFileInfo( nn, (fd->getPath()).c_str(), &fstatus, 0);
+
+    if ( !result.ok() )
+    {
+        isilonFreeHDFSObjs( 1, &fstatus);
+
+        return PASS( result);
+    }
+
+    struct hdfs_file_status *f_stat = &fstatus->ob_val._file_status;
+
+    result = ISILON_ASSERT_ERROR( f_stat->_size + fd->getBuffOffset() ==
+                                      (unsigned long long)fd->getOffset(),
+                                  ISILON_ERR_UNEXPECTED_OFFSET, file_id,
+                                  fd->getFileSize(), fd->getOffset());
+    isilonFreeHDFSObjs( 1, &fstatus);
+    ISILON_ERROR_CHECK( result);
+#endif
+
+    ISILON_LOG( "\tWriting to file: %s (id: %d)", (fd->getPath()).c_str(), file_id);
+    result = isilonWriteBuf( nn, file_id, (char *)_buf,
+                             _len, status);
 
-    struct hdfs_namenode *nn = conn->getNameNode();
-    struct hdfs_object *exception = 0;
-    isilonFileDesc *fd = 0;
-    
-    result = isilonGetFileDescByID( file_id, &fd);
     ISILON_ERROR_CHECK_PASS( result);
 
-    isilon_file_handle file_handle( file_id, isilonDestroyObjDesc);
-    isilonFileMode mode = fd->getMode();
-    const char *path = fd->getPath().c_str();
+    return result;
+}
 
-    ISILON_LOG( "\tFile to close: %s (id: %d)", path, file_id);
+/**
+ * Get sequence of blocks covering 'len' bytes of a file from 'offset'
+ *
+ * The sequence is taken from the block location cache of a file
+ * descriptor. Name Node is asked for block locations only if the cache
+ * has no information about the requested region. In this case locations
+ * are requested in a large batch, so that subsequent reads are served
+ * from the cache
+ */
+ISILON_LOCAL irods::error isilonGetBlockSeq( struct hdfs_namenode *nn,
+                                            const char *path,
+                                            isilonBlockMap *block_map,
+                                            long long offset,
+                                            int len,
+                                            isilonBlockSeqPtr *block_seq,
+                                            int *status)
+{
+    irods::error result = SUCCESS();
 
-    if ( mode == ISILON_MODE_WRITE )
+    *block_seq = block_map->lookup( offset, len);
+
+    if ( *block_seq )
     {
-        int buff_offset = fd->getBuffOffset();
+        ISILON_LOG( "\t\t\tBlock sequence for %d bytes from offset %lld found in cache",
+                    len, offset);
 
-        if ( buff_offset )
-        {
-            const char *buff = 0;
+        return result;
+    }
 
-            /* Commit block to HDFS */
-            ISILON_LOG( "\tFile buffer is not empty (%d bytes). Committing to HDFS",
-                        buff_offset);
-            result = fd->flushBuff( &buff);
-            ISILON_ERROR_CHECK_PASS( result);
-            result = isilonCommitBufferToHDFS( nn, path, buff, buff_offset,
-                                               fd->getLastBlock(), status);
+    struct hdfs_object *exception = 0;
+    long long batch_len = len > ISILON_BLOCK_MAP_BATCH_SIZE ? len : ISILON_BLOCK_MAP_BATCH_SIZE;
+    struct hdfs_object *located_blocks = hdfs_getBlockLocations( nn,
+                                                                 path,
+                                                                 offset,
+                                                                 batch_len,
+                                                                 &exception);
+
+    ISILON_LOG( "\t\t\tBlock sequence obtained for %lld bytes from offset %lld",
+                batch_len, offset);
+    result = ISILON_ASSERT_ERROR( !exception, ISILON_ERR_GET_BLOCK_LOCATIONS_FAIL,
+                                  exception ? hdfs_exception_get_message( exception) : 0);
 
-            if ( fd->getLastBlock() )
-            {
-                /* Actually may skip this, but do it for explicity */
-                fd->releaseLastBlock();
-            } 
+    if ( !result.ok() )
+    {
+        isilonGetErrCodeFromException( exception, status);
+        isilonFreeHDFSObjs( 2, &exception, &located_blocks);
 
-            if ( !result.ok() )
-            {
-                *status = EIO;
+        return result;
+    }
 
-                return PASS( result);
+    result = ISILON_ASSERT_ERROR( located_blocks->ob_type != H_NULL,
+                                  ISILON_ERR_FILE_NOT_EXIST, path);
+
+    if ( !result.ok() )
+    {
+        isilonFreeHDFSObjs( 2, &exception, &located_blocks);
+        *status = EIO;
+
+        return result;
+    }
+
+    /* The map takes care of the sequence from now on */
+    *block_seq = block_map->update( located_blocks);
+
+    return result;
+}
+
+/**
+ * Perform block read 'read' of file 'path' using the block cache
+ *
+ * Only reads of whole blocks populate the cache. Partial reads are
+ * served by the cache if the block is already there, and go to a Data
+ * Node otherwise. The read continues from the first byte not read yet.
+ * If it fails, the Data Node which failed is added to the excluded ones
+ */
+ISILON_LOCAL irods::error isilonReadBlockCached( const char *path,
+                                                isilonBlockRead *read,
+                                                const isilonIOParams& io_params)
+{
+    irods::error result = SUCCESS();
+    struct hdfs_located_block *lb = &read->block->ob_val._located_block;
+    isilonCachedBlockPtr cached;
+    std::string key;
+    std::string addr;
+    bool loader = false;
+    int64_t done = 0;
+
+    /* Descriptors opened with "nocache" hint bypass the cache */
+    if ( BLOCK_CACHE.isEnabled() && io_params.block_cache_size )
+    {
+        std::stringstream ss;
+        bool whole = !read->done && !read->block_offset && read->len == lb->_len;
+
+        /* Unverified data should not be served to readers verifying checksums */
+        ss << path << ':' << lb->_blockid << ':' << lb->_generation
+           << (io_params.verify_checksums ? ":crc" : "");
+        key = ss.str();
+        cached = BLOCK_CACHE.acquire( key, read->block_offset + read->len, whole, &loader);
+    }
+
+    if ( !cached )
+    {
+        result = isilonReadBlock( read->block, read->block_offset + read->done,
+                                  read->len - read->done, read->buf + read->done,
+                                  io_params, read->excluded, read->segmented, &done, &addr);
+        read->done += done;
+    } else if ( loader )
+    {
+        result = isilonReadBlock( read->block, 0, cached->len, cached->data,
+                                  io_params, read->excluded, read->segmented, &done, &addr);
+        BLOCK_CACHE.completeLoad( key, result.ok());
+        /* The whole block is requested, so whatever is loaded
+           belongs to the request */
+        memcpy( read->buf, cached->data, done);
+        read->done = done;
+    } else
+    {
+        ISILON_LOG( "\t\t\t\tBlock %lld found in block cache", (long long)lb->_blockid);
+        memcpy( read->buf, cached->data + read->block_offset, read->len);
+        read->done = read->len;
+    }
+
+    if ( !result.ok() && !addr.empty() )
+    {
+        read->excluded.push_back( addr);
+    }
+
+    return result;
+}
+
+/**
+ * Perform block reads taken from a queue until the queue is exhausted
+ *
+ * A failed read does not stop the others, it is retried once
+ * all the reads are over
+ */
+ISILON_LOCAL void isilonBlockReadWorker( isilonBlockReadQueue *queue)
+{
+    for ( ;; )
+    {
+        isilonBlockRead *read = 0;
+
+        {
+            boost::lock_guard<boost::mutex> lock( queue->mutex);
+
+            if ( queue->next == queue->reads.size() )
+            {
+                return;
             }
+
+            read = &queue->reads[queue->next++];
         }
 
-        bool is_ok = hdfs_complete( nn, path, HDFS_CLIENT, &exception);
+        double start = isilonGetTime();
+        irods::error result = isilonReadBlockCached( queue->path, read, *queue->io_params);
+        double elapsed = isilonGetTime() - start;
 
-        result = ISILON_ASSERT_ERROR( !exception, ISILON_ERR_COMPLETE_FAIL,
-                                      exception ? hdfs_exception_get_message( exception) : 0);
-        ISILON_LOG( "\tFile %s completed", path);
+        boost::lock_guard<boost::mutex> lock( queue->mutex);
+
+        queue->busy_time += elapsed;
 
         if ( !result.ok() )
         {
-            isilonGetErrCodeFromException( exception, status);
-            isilonFreeHDFSObjs( 1, &exception);
+            ISILON_LOG( "\t\t\t\tRead of %ld bytes from block offset %ld failed after %ld bytes",
+                        read->len, read->block_offset, read->done);
 
-            return result;
+            if ( queue->result.ok() )
+            {
+                queue->result = result;
+            }
+
+            continue;
         }
 
-        result = ISILON_ASSERT_ERROR( is_ok, ISILON_ERR_FILE_NOT_COMPLETED,
-                                      path);
+        ISILON_LOG( "\t\t\t\tRead %ld bytes from block offset %ld in %.3f s",
+                    read->len, read->block_offset, elapsed);
+    }
+}
+
+/**
+ * Retry failed block read 'read' of file 'path'
+ *
+ * Up to ISILON_READ_RETRIES attempts are made with exponential backoff.
+ * Before each attempt block locations are refreshed from Name Node, since
+ * the block might have been moved. Retries are made in segments, so each
+ * of them continues after the last segment read so far. Data Nodes which
+ * failed the read are tried last. Refreshed block sequences are kept in
+ * 'block_seqs' while the read refers to them
+ */
+ISILON_LOCAL irods::error isilonRetryBlockRead( struct hdfs_namenode *nn,
+                                               const char *path,
+                                               isilonBlockMap *block_map,
+                                               const isilonIOParams& io_params,
+                                               isilonBlockRead *read,
+                                               std::vector<isilonBlockSeqPtr> *block_seqs,
+                                               int *status)
+{
+    irods::error result = SUCCESS();
+
+    for ( int attempt = 1; attempt <= ISILON_READ_RETRIES; attempt++ )
+    {
+        struct hdfs_located_block *lb = &read->block->ob_val._located_block;
+        long long offset = lb->_offset + read->block_offset + read->done;
+        int len = read->len - read->done;
+        struct hdfs_object *block = 0;
+        isilonBlockSeqPtr block_seq;
+
+        usleep( (ISILON_READ_RETRY_DELAY << (attempt - 1)) * 1000);
+        ISILON_LOG( "\t\t\tRetrying read of %d bytes from offset %lld, attempt %d",
+                    len, offset, attempt);
+        block_map->invalidate();
+        result = isilonGetBlockSeq( nn, path, block_map, offset, len, &block_seq, status);
+        ISILON_ERROR_CHECK_PASS( result);
+        block_seqs->push_back( block_seq);
+
+        for ( int i = 0; i < block_seq->ob_val._located_blocks._num_blocks; i++ )
+        {
+            struct hdfs_object *b = block_seq->ob_val._located_blocks._blocks[i];
+
+            if ( b->ob_val._located_block._offset <= offset
+                 && offset < b->ob_val._located_block._offset + b->ob_val._located_block._len )
+            {
+                block = b;
+                break;
+            }
+        }
+
+        result = ISILON_ASSERT_ERROR( block && offset + len <= block->ob_val._located_block._offset
+                                                               + block->ob_val._located_block._len,
+                                      ISILON_ERR_CORRUPTED_OR_INCORRECT_BLOCK, offset, (long long)len);
 
         if ( !result.ok() )
         {
-            isilonFreeHDFSObjs( 1, &exception);
             *status = EIO;
 
             return result;
         }
-    } else
-    {
-        result = ISILON_ASSERT_ERROR( mode == ISILON_MODE_READ,
-                                      ISILON_ERR_MODE_NOT_SUPPORTED);
 
-        if ( !result.ok() )
-        {
-            isilonFreeHDFSObjs( 1, &exception);
+        read->buf += read->done;
+        read->block = block;
+        read->block_offset = offset - block->ob_val._located_block._offset;
+        read->len = len;
+        read->done = 0;
+        read->segmented = true;
+        result = isilonReadBlockCached( path, read, io_params);
 
+        if ( result.ok() )
+        {
             return result;
         }
     }
 
-    isilonFreeHDFSObjs( 1, &exception);
+    *status = EIO;
 
-    return result;
+    return PASS( result);
 }
 
 /**
- * Write data to a buffer and commit to HDFS Data Node (if the buffer is filled)
+ * Split reading of 'len' bytes from 'offset' into the reads of blocks
+ * of 'block_seq'. Data of each block go to their own part of 'buf'
  */
-ISILON_LOCAL irods::error isilonWriteBuf( struct hdfs_namenode *nn,
-                                          int id,
-                                          const char *buf,
-                                          int len,
-                                          int *status)
+ISILON_LOCAL irods::error isilonAddBlockReads( isilonBlockSeqPtr block_seq,
+                                              isilonBlockMap *block_map,
+                                              char *buf,
+                                              long long offset,
+                                              int len,
+                                              std::vector<isilonBlockRead> *reads,
+                                              int *status)
 {
     irods::error result = SUCCESS();
-    /* check incoming parameters */
-    bool check_expr = nn && buf && status;
+    int block_num = block_seq->ob_val._located_blocks._num_blocks;
+    /* We track the number of bytes remained to read. This is a workaround
+       for a bug in Isilon 8. Sometimes Isilon returns redundant blocks
+       at the end of the block sequence. Those redundant blocks are invalid and
+       cannot be read. But we can skip them and stop reading, since all the
+       requested data is already contained in previous - valid - blocks in
+       the sequence. To skip redundant blocks, we use this 'to_read' variable.
+       When no data remains to be read, we just break the reading loop.
+       In absence of the bug we could just read the entire sequence of blocks
+       without controlling the size of already transferred data */
+    int to_read = len;
 
-    result = ISILON_ASSERT_ERROR( check_expr, ISILON_ERR_NULL_ARGS);
-    ISILON_ERROR_CHECK( result);
+    ISILON_LOG( "\t\t\tBlocks in the sequence: %d", block_num);
 
-    isilonFileDesc *fd = 0;
+    /* We may need to read multiple blocks to satisfy the read */
+    for ( int i = 0; i < block_num; i++)
+    {
+        struct hdfs_object *block = block_seq->ob_val._located_blocks._blocks[i];
+        int64_t block_begin = 0;
+        int64_t block_end = block->ob_val._located_block._len;
+        int64_t block_offset = block->ob_val._located_block._offset;
 
-    result = isilonGetFileDescByID( id, &fd);
-    ISILON_ERROR_CHECK_PASS( result);
-    result = ISILON_ASSERT_ERROR( fd->getMode() == ISILON_MODE_WRITE,
-                                  ISILON_ERR_UNEXPECTED_MODE, fd->getMode(),
-                                  ISILON_MODE_WRITE);
-    ISILON_ERROR_CHECK( result);
-    result = ISILON_ASSERT_ERROR( fd->getFileSize() == fd->getOffset(),
-                                  ISILON_ERR_UNEXPECTED_OFFSET, id,
-                                  fd->getFileSize(), fd->getOffset());
-    ISILON_ERROR_CHECK( result);
+        /* The cached sequence usually covers much more than requested.
+           Skip blocks out of the requested region */
+        if ( block_offset + block_end <= offset )
+        {
+            continue;
+        }
 
-    int buf_offset = 0;
+        ISILON_LOG( "\t\t\tReading from block %d in the sequence", i);
+        result = ISILON_ASSERT_ERROR( block_offset < offset + len,
+                                      ISILON_ERR_CORRUPTED_OR_INCORRECT_BLOCK, block_offset, block_end);
 
-    while ( len )
-    {
-        const char *wbuff = 0;
-        int wbuff_size = fd->getBuffSize();
-        int wbuff_offset = fd->getBuffOffset();
-        int bytes_added = 0;
+        if ( !result.ok() )
+        {
+            /* Not the cached sequence should be blamed, but just in case */
+            block_map->invalidate();
+            *status = EIO;
+
+            return result;
+        }
 
-        if ( len >= wbuff_size && wbuff_offset == 0 )
+        /* For each block, read the relevant part into the buffer */
+        if ( block_offset < offset )
         {
-            /* Size of data to write is bigger or equal to buffer size and
-               the buffer is currently empty. So we can skip bufferization
-               step and commit the data directly to HDFS */
-            wbuff = buf + buf_offset;
-            buf_offset += wbuff_size;
-            bytes_added = wbuff_size;
-            len -= wbuff_size;
-        } else
+            block_begin = offset - block_offset;
+        }
+
+        if ( block_offset + block_end > offset + len)
         {
-            int buff_avail = wbuff_size - wbuff_offset;
+            block_end = offset + len - block_offset;
+        }
 
-            if ( buff_avail > len )
-            {
-                result = fd->writeToBuff( buf, buf_offset, len);
-                ISILON_ERROR_CHECK_PASS( result);
-                buf_offset += len;
-                bytes_added = len;
-                len = 0;
-            } else
-            {
-                result = fd->writeToBuff( buf, buf_offset, buff_avail);
-                ISILON_ERROR_CHECK_PASS( result);
-                len -= buff_avail;
-                buf_offset += buff_avail;
-                bytes_added = buff_avail;
-                result = fd->flushBuff( &wbuff);
-                ISILON_ERROR_CHECK_PASS( result);
-            }
+        isilonBlockRead read( block, block_begin/* offset in block */,
+                              block_end - block_begin/* len */,
+                              buf + (block_offset + block_begin - offset));
+
+        reads->push_back( read);
+        to_read -= (block_end - block_begin);
+
+        if ( !to_read )
+        {
+            break;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Perform the block reads of 'queue'
+ *
+ * Blocks usually reside on different Data Nodes, so up to 'read_threads'
+ * of them (see I/O parameters) are fetched concurrently. Failed reads
+ * are retried by the current thread after all the reads are over
+ */
+ISILON_LOCAL irods::error isilonPerformBlockReads( struct hdfs_namenode *nn,
+                                                  const char *path,
+                                                  isilonBlockMap *block_map,
+                                                  const isilonIOParams& io_params,
+                                                  isilonBlockReadQueue *queue,
+                                                  int *status)
+{
+    irods::error result = SUCCESS();
+    /* The current thread takes part in reading as well */
+    boost::thread_group workers;
+    int threads_num = std::min( io_params.read_threads, (int)queue->reads.size());
+#ifdef ISILON_DEBUG
+    double start = isilonGetTime();
+    int64_t len = 0;
+
+    for ( size_t i = 0; i < queue->reads.size(); i++ )
+    {
+        len += queue->reads[i].len;
+    }
+#endif
+
+    for ( int i = 1; i < threads_num; i++ )
+    {
+        workers.add_thread( new boost::thread( isilonBlockReadWorker, queue));
+    }
+
+    isilonBlockReadWorker( queue);
+    workers.join_all();
 
-            /* We use 'wbuff_offset + bytes_added' for buffer payload size
-               instead of 'fd->getBuffSize()' because the buffer might be flushed */
-            ISILON_LOG( "\t\t%d bytes bufferized. Currently in buffer: %d",
-                        bytes_added, wbuff_offset + bytes_added);
-        }
+#ifdef ISILON_DEBUG
+    double elapsed = isilonGetTime() - start;
+
+    /* Per-thread throughput lets checksum verification cost be compared
+       against plain transfers */
+    ISILON_LOG( "\t\t\t%lld bytes transferred in %.3f s by %d thread(s): %.1f Mb/s total, "
+                "%.1f Mb/s per thread, checksums %s",
+                (long long)len, elapsed, threads_num > 0 ? threads_num : 1,
+                elapsed > 0 ? len / elapsed / (1024 * 1024) : 0.0,
+                queue->busy_time > 0 ? len / queue->busy_time / (1024 * 1024) : 0.0,
+                io_params.verify_checksums ? "verified" : "not verified");
+#endif
 
-        if ( wbuff )
-        {
-            /* Commit block to HDFS */
-            ISILON_LOG( "\t\tBuffer is full. Committing to HDFS");
-            result = isilonCommitBufferToHDFS( nn, fd->getPath().c_str(), wbuff,
-                                               wbuff_size, fd->getLastBlock(), status);
-            ISILON_ERROR_CHECK_PASS( result);
+    if ( !queue->result.ok() )
+    {
+        std::vector<isilonBlockSeqPtr> block_seqs;
 
-            if ( fd->getLastBlock() )
+        for ( size_t i = 0; i < queue->reads.size(); i++ )
+        {
+            if ( queue->reads[i].done < queue->reads[i].len )
             {
-                fd->releaseLastBlock();
+                result = isilonRetryBlockRead( nn, path, block_map, io_params,
+                                               &queue->reads[i], &block_seqs, status);
+                ISILON_ERROR_CHECK_PASS( result);
             }
         }
-
-        /* Only at this point we know that the data were placed to buffer
-           or committed directly to HDFS. Only now we can adjust the file offset */
-#ifdef ISILON_DEBUG
-        isilonSetObjOffsetByID( id, fd->getOffset() + bytes_added);
-#else
-        fd->setOffset( fd->getOffset() + bytes_added);
-#endif
-        /* After any write operation made inside this plugin, file size
-           should be equal to file offset, since only writes to the end
-           of the file are allowed */
-        fd->setFileSize( fd->getOffset());
     }
 
     return result;
 }
 
 /**
- * Write data to the specified file
+ * Retrieve a new chunk of data from Data Nodes
+ *
+ * Each block of the chunk is fetched into its own part of the buffer,
+ * several blocks concurrently
  */
-ISILON_LOCAL irods::error isilonWriteFile( isilonConnectionDesc *conn,
-                                           int                  file_id,
-                                           void                 *_buf,
-                                           int                  _len,
-                                           int                  *status)
+ISILON_LOCAL irods::error isilonFillBufferFromHDFS( struct hdfs_namenode *nn,
+                                                    const char *path,
+                                                    isilonBlockMap *block_map,
+                                                    const isilonIOParams& io_params,
+                                                    char *buf,
+                                                    long long offset,
+                                                    int len,
+                                                    int *status)
 {
     irods::error result = SUCCESS();
-
     /* check incoming parameters */
-    bool check_expr = conn && _buf && status;
+    bool check_expr = nn && path && block_map && buf && status;
 
     result = ISILON_ASSERT_ERROR( check_expr, ISILON_ERR_NULL_ARGS);
     ISILON_ERROR_CHECK( result);
+
+    isilonBlockSeqPtr block_seq;
+    isilonBlockReadQueue queue( path, &io_params);
+
     *status = 0;
+    result = isilonGetBlockSeq( nn, path, block_map, offset, len, &block_seq, status);
+    ISILON_ERROR_CHECK_PASS( result);
+    result = isilonAddBlockReads( block_seq, block_map, buf, offset, len,
+                                  &queue.reads, status);
+    ISILON_ERROR_CHECK_PASS( result);
+    result = isilonPerformBlockReads( nn, path, block_map, io_params, &queue, status);
+    ISILON_ERROR_CHECK_PASS( result);
 
-    struct hdfs_namenode *nn = conn->getNameNode();
+    return result;
+}
 
-#ifdef ISILON_DEBUG
-    /* Sanity check. For now current file offset should be equal to
-       file size + size of bufferized data */
-    isilonFileDesc *fd = 0;
+/**
+ * Read several regions of file 'fd' at once
+ *
+ * Block locations for all the regions are looked up together (a single
+ * Name Node request as long as the regions are not too far from each
+ * other). Reads of the same block are merged if they are close, and all
+ * the block reads are performed concurrently. Read windows and the file
+ * offset are not affected
+ */
+ISILON_LOCAL irods::error isilonReadVec( struct hdfs_namenode *nn,
+                                        isilonFileDesc *fd,
+                                        std::vector<isilonReadRange>& ranges,
+                                        int *status)
+{
+    irods::error result = SUCCESS();
+    const char *path = fd->getPath().c_str();
+    isilonBlockMap *block_map = fd->getBlockMap();
+    const isilonIOParams& io_params = fd->getIOParams();
+    std::vector<isilonBlockSeqPtr> block_seqs;
+    std::vector<isilonBlockRead> pieces;
+    std::vector<size_t> order;
+    long long begin = -1;
+    long long end = 0;
 
-    result = isilonGetFileDescByID( file_id, &fd);
-    ISILON_ERROR_CHECK_PASS( result);
+    *status = 0;
 
-    struct hdfs_object *fstatus = 0;
+    for ( size_t i = 0; i < ranges.size(); i++ )
+    {
+        isilonReadRange *range = &ranges[i];
+        long long rest = fd->getFileSize() - range->offset;
 
-    result = isilonGetHDFSFileInfo( nn, (fd->getPath()).c_str(), &fstatus, 0);
+        range->len = (range->offset < 0 || rest <= 0) ? 0 : std::min( (long long)range->len, rest);
 
-    if ( !result.ok() )
+        if ( range->len > 0 )
+        {
+            begin = (begin < 0) ? range->offset : std::min( begin, range->offset);
+            end = std::max( end, range->offset + range->len);
+            order.push_back( i);
+        }
+    }
+
+    if ( begin < 0 )
     {
-        isilonFreeHDFSObjs( 1, &fstatus);
+        return result;
+    }
 
-        return PASS( result);
+    ISILON_LOG( "\t\tVectored read of %lu range(s) from %lld to %lld",
+                order.size(), begin, end);
+
+    /* Looking the ranges up in the order of offsets lets all of them
+       be served by the block locations requested for the first one */
+    std::sort( order.begin(), order.end(),
+               [&ranges]( size_t a, size_t b) { return ranges[a].offset < ranges[b].offset; });
+
+    isilonBlockSeqPtr block_seq;
+
+    result = isilonGetBlockSeq( nn, path, block_map, begin,
+                                std::min( end - begin, ISILON_BLOCK_MAP_BATCH_SIZE),
+                                &block_seq, status);
+    ISILON_ERROR_CHECK_PASS( result);
+
+    for ( size_t i = 0; i < order.size(); i++ )
+    {
+        isilonReadRange *range = &ranges[order[i]];
+
+        result = isilonGetBlockSeq( nn, path, block_map, range->offset, range->len,
+                                    &block_seq, status);
+        ISILON_ERROR_CHECK_PASS( result);
+        block_seqs.push_back( block_seq);
+        result = isilonAddBlockReads( block_seq, block_map, range->buf, range->offset,
+                                      range->len, &pieces, status);
+        ISILON_ERROR_CHECK_PASS( result);
     }
 
-    struct hdfs_file_status *f_stat = &fstatus->ob_val._file_status;
+    std::sort( pieces.begin(), pieces.end(),
+               []( const isilonBlockRead& a, const isilonBlockRead& b)
+               {
+                   int64_t id_a = a.block->ob_val._located_block._blockid;
+                   int64_t id_b = b.block->ob_val._located_block._blockid;
 
-    result = ISILON_ASSERT_ERROR( f_stat->_size + fd->getBuffOffset() ==
-                                      (unsigned long long)fd->getOffset(),
-                                  ISILON_ERR_UNEXPECTED_OFFSET, file_id,
-                                  fd->getFileSize(), fd->getOffset());
-    isilonFreeHDFSObjs( 1, &fstatus);
-    ISILON_ERROR_CHECK( result);
-#endif
+                   return id_a < id_b || (id_a == id_b && a.block_offset < b.block_offset);
+               });
 
-    ISILON_LOG( "\tWriting to file: %s (id: %d)", (fd->getPath()).c_str(), file_id);
-    result = isilonWriteBuf( nn, file_id, (char *)_buf,
-                             _len, status);
+    isilonBlockReadQueue queue( path, &io_params);
+    std::list< std::vector<char> > buffers;
+    std::vector<isilonMergedRead> merged;
+
+    for ( size_t i = 0; i < pieces.size(); )
+    {
+        int64_t blockid = pieces[i].block->ob_val._located_block._blockid;
+        int64_t read_end = pieces[i].block_offset + pieces[i].len;
+        size_t j = i + 1;
+
+        while ( j < pieces.size()
+                && pieces[j].block->ob_val._located_block._blockid == blockid
+                && pieces[j].block_offset <= read_end + ISILON_READ_VEC_MERGE_GAP )
+        {
+            read_end = std::max( read_end, pieces[j].block_offset + pieces[j].len);
+            j++;
+        }
+
+        if ( j == i + 1 )
+        {
+            queue.reads.push_back( pieces[i]);
+        } else
+        {
+            isilonMergedRead mr;
+
+            buffers.push_back( std::vector<char>( read_end - pieces[i].block_offset));
+            mr.data = &buffers.back()[0];
+            mr.block_offset = pieces[i].block_offset;
+            mr.pieces.assign( pieces.begin() + i, pieces.begin() + j);
+            merged.push_back( mr);
+
+            isilonBlockRead read( pieces[i].block, mr.block_offset,
+                                  read_end - mr.block_offset, mr.data);
+
+            queue.reads.push_back( read);
+        }
+
+        i = j;
+    }
 
+    ISILON_LOG( "\t\t%lu block read(s) out of %lu piece(s)", queue.reads.size(), pieces.size());
+    /* Merged reads go to their own memory, the pieces are copied out of it afterwards */
+    result = isilonPerformBlockReads( nn, path, block_map, io_params, &queue, status);
     ISILON_ERROR_CHECK_PASS( result);
 
+    for ( size_t i = 0; i < merged.size(); i++ )
+    {
+        for ( size_t j = 0; j < merged[i].pieces.size(); j++ )
+        {
+            isilonBlockRead *piece = &merged[i].pieces[j];
+
+            memcpy( piece->buf, merged[i].data + (piece->block_offset - merged[i].block_offset),
+                    piece->len);
+        }
+    }
+
     return result;
 }
 
 /**
- * Retrieve a new chunk of data from a Data Node
+ * Fill a window of a file opened in READ mode with data from HDFS
+ *
+ * The window should be prepared for the load by "beginWindow"
  */
-ISILON_LOCAL irods::error isilonFillBufferFromHDFS( struct hdfs_namenode *nn,
-                                                    const char *path,
-                                                    char *buf,
-                                                    long long offset,
-                                                    int len,
-                                                    int *status)
+ISILON_LOCAL irods::error isilonFillWindow( struct hdfs_namenode *nn,
+                                           isilonFileDesc *fd,
+                                           int win,
+                                           int *status)
 {
     irods::error result = SUCCESS();
-    /* check incoming parameters */
-    bool check_expr = nn && path && buf && status;
+    isilonReadWindow *w = fd->getWindow( win);
+
+    ISILON_LOG( "\t\tFilling window %d: %lu bytes from offset %lld (%lu bytes of history)",
+                win, w->len - w->hist_len, w->offset + w->hist_len, w->hist_len);
+    result = isilonFillBufferFromHDFS( nn, (fd->getPath()).c_str(), fd->getBlockMap(),
+                                       fd->getIOParams(),
+                                       w->data + w->hist_len, w->offset + w->hist_len,
+                                       w->len - w->hist_len, status);
+    fd->completeWindow( win, result.ok());
+    ISILON_ERROR_CHECK_PASS( result);
 
-    result = ISILON_ASSERT_ERROR( check_expr, ISILON_ERR_NULL_ARGS);
-    ISILON_ERROR_CHECK( result);
+    return result;
+}
 
-    struct hdfs_object *exception = 0;
-    struct hdfs_object *block_seq = hdfs_getBlockLocations( nn,
-                                                            path,
-                                                            offset,
-                                                            len,
-                                                            &exception);
+/**
+ * Body of the read-ahead thread
+ *
+ * Errors are not reported from here: a window which failed to load
+ * stays empty and is loaded once again (and the error is reported)
+ * when a reader reaches it
+ */
+ISILON_LOCAL void isilonReadAheadWorker( struct hdfs_namenode *nn,
+                                         isilonFileDesc *fd,
+                                         int win)
+{
+    int status = 0;
 
-    *status = 0;
-    ISILON_LOG( "\t\t\tBlock sequence obtained for %d bytes from offset %lld", len, offset);
-    result = ISILON_ASSERT_ERROR( !exception, ISILON_ERR_GET_BLOCK_LOCATIONS_FAIL,
-                                  exception ? hdfs_exception_get_message( exception) : 0);
+    isilonFillWindow( nn, fd, win, &status);
+}
 
-    if ( !result.ok() )
+/**
+ * Start loading the window which is expected to be read after the window
+ * holding the current file offset, so that the data are fetched from HDFS
+ * while the current window is being consumed
+ *
+ * The window follows the current one for sequential access, precedes it
+ * for reverse access and starts at the first record beyond the current
+ * window for strided access. Nothing is read ahead for random access
+ * and beyond the part of the file read by descriptor 'id' when other
+ * descriptors read the file in parallel
+ */
+ISILON_LOCAL irods::error isilonStartReadAhead( struct hdfs_namenode *nn,
+                                               int id,
+                                               isilonFileDesc *fd)
+{
+    irods::error result = SUCCESS();
+
+#ifdef ISILON_NO_CACHED_CONNECTIONS
+    /* Name Node connection is closed at the end of each plugin operation
+       in this mode, so it cannot be used by a background thread */
+    return result;
+#endif
+
+    isilonAccessPattern *pattern = fd->getAccessPattern();
+
+    /* Only one window is loaded in background at a time */
+    if ( !fd->isReadAhead() || fd->isLoading()
+         || pattern->getPattern() == ISILON_ACCESS_RANDOM )
     {
-        isilonGetErrCodeFromException( exception, status);
-        isilonFreeHDFSObjs( 2, &exception, &block_seq);
+        return result;
+    }
 
+    int cur_win = fd->coveringWindow( fd->getOffset());
+
+    if ( cur_win < 0 )
+    {
         return result;
     }
 
-    result = ISILON_ASSERT_ERROR( block_seq->ob_type != H_NULL,
-                                  ISILON_ERR_FILE_NOT_EXIST);
+    isilonReadWindow *w = fd->getWindow( cur_win);
+    long long next_offset = w->offset + w->len;
+    /* Byte which will be needed first */
+    long long next_byte = next_offset;
 
-    if ( !result.ok() )
+    if ( pattern->getPattern() == ISILON_ACCESS_REVERSE )
     {
-        isilonFreeHDFSObjs( 2, &exception, &block_seq);
-        *status = EIO;
+        next_offset = w->offset;
+        next_byte = next_offset - 1;
+    } else if ( pattern->getPattern() == ISILON_ACCESS_STRIDED )
+    {
+        next_offset = pattern->predictFrom( next_offset);
+        next_byte = next_offset;
+    }
 
+    /* Either an end of file is reached or the next window is already loaded */
+    if ( next_byte < 0 || next_byte >= fd->getFileSize()
+         || fd->coveringWindow( next_byte) >= 0 )
+    {
         return result;
     }
 
-    int block_num = block_seq->ob_val._located_blocks._num_blocks;
-    /* We track the number of bytes remained to read. This is a workaround
-       for a bug in Isilon 8. Sometimes Isilon returns redundant blocks
-       at the end of the block sequence. Those redundant blocks are invalid and
-       cannot be read. But we can skip them and stop reading, since all the
-       requested data is already contained in previous - valid - blocks in
-       the sequence. To skip redundant blocks, we use this 'to_read' variable.
-       When no data remains to be read, we just break the reading loop.
-       In absence of the bug we could just read the entire sequence of blocks
-       without controlling the size of already transferred data */
-    int to_read = len;
+    long long part_end = PARALLEL_READERS.getPartEnd( fd->getPath(), id,
+                             PARALLEL_READERS.getPartStart( fd->getPath(), id));
 
-    ISILON_LOG( "\t\t\tBlocks in the sequence: %d", block_num);
+    if ( part_end >= 0 && next_byte >= part_end )
+    {
+        ISILON_LOG( "\t\tNo read-ahead beyond offset %lld: another reader's part starts there",
+                    part_end);
+        return result;
+    }
 
-    /* We may need to read multiple blocks to satisfy the read */
-    for ( int i = 0; i < block_num; i++)
+    int win = fd->getFreeWindow( fd->getOffset());
+
+    if ( win < 0 )
     {
-        struct hdfs_object *block = block_seq->ob_val._located_blocks._blocks[i];
-        const char *err = 0;
-        int64_t block_begin = 0;
-        int64_t block_end = block->ob_val._located_block._len;
-        int64_t block_offset = block->ob_val._located_block._offset;
+        return result;
+    }
 
-        ISILON_LOG( "\t\t\tReading from block %d in the sequence", i);
-        result = ISILON_ASSERT_ERROR( block_offset + block_end > offset
-                                      && block_offset < offset + len,
-                                      ISILON_ERR_CORRUPTED_OR_INCORRECT_BLOCK, block_offset, block_end);
+    long long start = 0;
+    unsigned long to_get = 0;
 
-        if ( !result.ok() )
-        {
-            isilonFreeHDFSObjs( 2, &exception, &block_seq);
-            *status = EIO;
+    fd->fillRange( next_offset, 0, part_end, &start, &to_get);
 
-            return result;
-        }
+    /* Previous job is complete at this point (no window is loading),
+       so the join below doesn't block */
+    fd->waitReadAhead();
+    result = fd->beginWindow( win, start, to_get);
+    ISILON_ERROR_CHECK_PASS( result);
+    ISILON_LOG( "\t\tRead-ahead of %lu bytes from offset %lld started (%s access)", to_get,
+                start, isilonAccessPattern::getName( pattern->getPattern()));
+    fd->getReadAheadThread() = boost::thread( isilonReadAheadWorker, nn, fd, win);
+
+    return result;
+}
+
+/**
+ * Read data of a file opened in random-access mode
+ *
+ * Only the pages touched by the read are fetched from HDFS. Recently
+ * used pages are kept, so that reads around the same offsets are
+ * served locally. Missing pages of a read spanning several pages
+ * are fetched by a single vectored read
+ */
+ISILON_LOCAL irods::error isilonReadPages( struct hdfs_namenode *nn,
+                                           isilonFileDesc *fd,
+                                           char *buf,
+                                           long long to_read,
+                                           int *bytes_read,
+                                           int *status)
+{
+    irods::error result = SUCCESS();
+    isilonPageCache *pages = fd->getPages();
+    int buf_offset = 0;
+    long long first_page = fd->getOffset() - fd->getOffset() % ISILON_PAGE_SIZE;
+    long long last_page = fd->getOffset() + to_read - 1;
 
-        struct hdfs_datanode *dn = 0;
+    last_page -= last_page % ISILON_PAGE_SIZE;
 
-        dn = hdfs_datanode_new( block, HDFS_CLIENT, HDFS_DATANODE_AP_1_0, &err);
-        result = ISILON_ASSERT_ERROR( dn, ISILON_ERR_CONNECT_TO_DATANODE_FAIL, err,
-                                      block->ob_val._located_block._locs[0]->ob_val._datanode_info._hostname,
-                                      block->ob_val._located_block._locs[0]->ob_val._datanode_info._port);
+    /* Pages touched by the read must not evict each other */
+    if ( to_read && last_page > first_page
+         && (unsigned long)((last_page - first_page) / ISILON_PAGE_SIZE) < pages->getCapacity() )
+    {
+        std::vector<isilonReadRange> ranges;
 
-        if ( !result.ok() )
+        for ( long long page_offset = first_page; page_offset <= last_page;
+              page_offset += ISILON_PAGE_SIZE )
         {
-            isilonFreeHDFSObjs( 2, &exception, &block_seq);
-            *status = EIO;
+            if ( pages->find( page_offset) )
+            {
+                continue;
+            }
 
-            return result;
-        }
+            long long reminder = fd->getFileSize() - page_offset;
+            isilonPage *page = pages->insert( page_offset);
 
-        ISILON_LOG( "\t\t\t\tData node discovered: %s",
-                    block->ob_val._located_block._locs[0]->ob_val._datanode_info._hostname);
+            result = ISILON_ASSERT_ERROR( page, ISILON_ERR_NO_MEM);
 
-        /* For each block, read the relevant part into the buffer */
-        if ( block_offset < offset )
-        {
-            block_begin = offset - block_offset;
+            if ( !result.ok() )
+            {
+                break;
+            }
+
+            page->len = reminder > ISILON_PAGE_SIZE ? ISILON_PAGE_SIZE : reminder;
+
+            isilonReadRange range = { page_offset, (int)page->len, page->data };
+
+            ranges.push_back( range);
         }
 
-        if ( block_offset + block_end > offset + len)
+        if ( result.ok() && !ranges.empty() )
         {
-            block_end = offset + len - block_offset;
+            result = isilonReadVec( nn, fd, ranges, status);
         }
 
-        err = hdfs_datanode_read( dn, block_begin/* offset in block */,
-                                  block_end - block_begin/* len */, buf, false);
-        result = ISILON_ASSERT_ERROR( !err, ISILON_ERR_READ_FAIL, err);
-        hdfs_datanode_delete( dn);
-
         if ( !result.ok() )
         {
-            isilonFreeHDFSObjs( 2, &exception, &block_seq);
-            *status = EIO;
+            for ( size_t i = 0; i < ranges.size(); i++ )
+            {
+                pages->remove( ranges[i].offset);
+            }
 
-            return result;
+            return PASS( result);
         }
+    }
 
-        ISILON_LOG( "\t\t\t\tRead %ld bytes from block offset %ld",
-                    block_end - block_begin, block_begin);
-        buf = (char *)buf + (block_end - block_begin);
-        to_read -= (block_end - block_begin);
+    while ( to_read )
+    {
+        long long offset = fd->getOffset();
+        long long page_offset = offset - offset % ISILON_PAGE_SIZE;
+        isilonPage *page = pages->find( page_offset);
 
-        if ( !to_read )
+        if ( !page )
         {
-            break;
+            long long reminder = fd->getFileSize() - page_offset;
+
+            page = pages->insert( page_offset);
+            result = ISILON_ASSERT_ERROR( page, ISILON_ERR_NO_MEM);
+            ISILON_ERROR_CHECK( result);
+            page->len = reminder > ISILON_PAGE_SIZE ? ISILON_PAGE_SIZE : reminder;
+            ISILON_LOG( "\t\tFetching page of %lu bytes from offset %lld",
+                        page->len, page_offset);
+            result = isilonFillBufferFromHDFS( nn, (fd->getPath()).c_str(),
+                                               fd->getBlockMap(),
+                                               fd->getIOParams(),
+                                               page->data, page_offset,
+                                               page->len, status);
+
+            if ( !result.ok() )
+            {
+                pages->remove( page_offset);
+
+                return PASS( result);
+            }
         }
+
+        unsigned long page_pos = offset - page_offset;
+        long long bytes_taken = page->len - page_pos;
+
+        bytes_taken = (to_read < bytes_taken) ? to_read : bytes_taken;
+        memcpy( buf + buf_offset, page->data + page_pos, bytes_taken);
+        ISILON_LOG( "\t\t%lld bytes read from page at offset %lld", bytes_taken, page_offset);
+        buf_offset += bytes_taken;
+        to_read -= bytes_taken;
+        fd->setOffset( offset + bytes_taken);
     }
 
+    *bytes_read = buf_offset;
+
     return result;
 }
 
 /**
- * Read data from a local buffer and fetch them from
- * HDFS Data Node (if the buffer is empty)
+ * Read data from local read windows and fetch them from
+ * HDFS Data Node (if no window holds the data)
  */
 ISILON_LOCAL irods::error isilonReadBuf( struct hdfs_namenode *nn,
                                          int id,
@@ -1556,76 +3086,103 @@ ISILON_LOCAL irods::error isilonReadBuf( struct hdfs_namenode *nn,
                 fd->getFileSize() - fd->getOffset());
     ISILON_LOG( "\t\tBytes to read: %lld", to_read);
 
+    isilonWrittenDataPtr written = fd->getWrittenData();
+    /* Data just written to the file by this process are not fetched again.
+       Fills stop where they start */
+    long long written_start = written ? written->end - written->data.size() : -1;
+
+    if ( fd->isRandomAccess() )
+    {
+        if ( written )
+        {
+            buf_offset = written->read( buf, fd->getOffset(), to_read);
+            to_read -= buf_offset;
+            fd->setOffset( fd->getOffset() + buf_offset);
+        }
+
+        result = isilonReadPages( nn, fd, buf + buf_offset, to_read, bytes_read, status);
+        ISILON_ERROR_CHECK_PASS( result);
+        *bytes_read += buf_offset;
+
+        return result;
+    }
+
+    if ( to_read )
+    {
+        fd->getAccessPattern()->add( fd->getOffset(), to_read);
+        PARALLEL_READERS.add( fd->getPath(), id, fd->getOffset());
+    }
+
     while ( to_read )
     {
-        char *rbuff = 0;
-        /* When reading data "BuffOffset" property of file descriptor
-           actually means "number of bytes available in a buffer" */
-        int rbuff_offset = fd->getBuffOffset();
+        long long offset = fd->getOffset();
         int bytes_taken = 0;
+        int win = fd->findWindow( offset);
+        /* Where the part of the file read by another descriptor starts */
+        long long part_end = -1;
 
-        if ( to_read >= rbuff_size && rbuff_offset == 0 )
-        {
-            /* read buffer is empty and size of data to read is
-               bigger than buffer size. Bufferization step can be skipped.
-               The data will be transferred directly from HDFS to output buffer */
-            rbuff = buf + buf_offset;
-            buf_offset += rbuff_size;
-            bytes_taken = rbuff_size;
-            to_read -= rbuff_size;
-        } else
+        if ( win < 0 )
         {
-            if ( rbuff_offset > to_read )
-            {
-                result = fd->readFromBuff( buf, buf_offset, to_read);
-                ISILON_ERROR_CHECK_PASS( result);
-                buf_offset += to_read;
-                bytes_taken = to_read;
-                to_read = 0;
-            } else
+            part_end = PARALLEL_READERS.getPartEnd( fd->getPath(), id, offset);
+
+            if ( written_start > offset && (part_end < 0 || written_start < part_end) )
             {
-                /* We fall here not only in case when there is some data in
-                   the buffer but also when the buffer is not even allocated.
-                   In the latter case a code below makes no harm to offsets
-                   and buffers (becase call to "readFromBuff" actually reads
-                   zero bytes) */
-                result = fd->readFromBuff( buf, buf_offset, rbuff_offset);
-                ISILON_ERROR_CHECK_PASS( result);
-                to_read -= rbuff_offset;
-                buf_offset += rbuff_offset;
-                bytes_taken = rbuff_offset;
-                result = fd->flushBuff( (const char **)&rbuff);
-                ISILON_ERROR_CHECK_PASS( result);
+                part_end = written_start;
             }
-
-            /* We use 'rbuff_size - rbuff_offset - bytes_taken' for buffer payload
-               size instead of 'fd->getBuffSize()' because the buffer might be flushed */
-            ISILON_LOG( "\t\t%d bytes read. Currently remains in buffer: %d",
-                        bytes_taken, rbuff_offset - bytes_taken);
         }
 
-        if ( rbuff )
+        if ( written && offset >= written_start )
+        {
+            bytes_taken = written->read( buf + buf_offset, offset, to_read);
+            ISILON_LOG( "\t\t%d bytes read from written data", bytes_taken);
+        } else if ( win >= 0 )
+        {
+            bytes_taken = fd->readFromWindow( win, buf + buf_offset, offset, to_read);
+            ISILON_LOG( "\t\t%d bytes read from window %d", bytes_taken, win);
+        } else if ( to_read >= rbuff_size )
+        {
+            /* No window holds the data and size of data to read is
+               bigger than window size. Bufferization step can be skipped.
+               The data will be transferred directly from HDFS to output buffer */
+            bytes_taken = fd->limitFillEnd( offset, 0,
+                              fd->alignFillEnd( offset, offset + rbuff_size), part_end) - offset;
+            result = isilonFillBufferFromHDFS( nn, (fd->getPath()).c_str(),
+                                               fd->getBlockMap(),
+                                               fd->getIOParams(),
+                                               buf + buf_offset, offset,
+                                               bytes_taken, status);
+            ISILON_ERROR_CHECK_PASS( result);
+        } else
         {
-            /* Fill block from HDFS */
-            ISILON_LOG( "\t\tBuffer is empty. Filling from HDFS");
+            /* Fill window from HDFS */
+            ISILON_LOG( "\t\tNo window holds offset %lld. Filling from HDFS", offset);
+            win = fd->getFreeWindow( offset);
 
-            long long offset = fd->getOffset();
+            if ( win < 0 )
+            {
+                /* All windows are busy. Let the read-ahead finish its job */
+                fd->waitReadAhead();
+                win = fd->getFreeWindow( offset);
+            }
 
-            offset += fd->getBuffOffset() ? bytes_taken : 0;
+            long long start = 0;
+            unsigned long to_get = 0;
 
-            long long reminder = fd->getFileSize() - offset;
-            int to_get = reminder > rbuff_size ? rbuff_size : reminder;
+            fd->fillRange( offset, to_read, part_end, &start, &to_get);
+            result = fd->beginWindow( win, start, to_get);
+            ISILON_ERROR_CHECK_PASS( result);
+            result = isilonFillWindow( nn, fd, win, status);
+            ISILON_ERROR_CHECK_PASS( result);
 
-            if ( to_get )
-            {
-                result = isilonFillBufferFromHDFS( nn, (fd->getPath()).c_str(), rbuff,
-                                                   offset, to_get, status);
-                ISILON_ERROR_CHECK_PASS( result);
-            }
+            /* The data will be taken from the window at the next iteration */
+            continue;
         }
 
+        buf_offset += bytes_taken;
+        to_read -= bytes_taken;
+
         /* Only at this point we can be sure that data were successfully read
-           from temporary buffer or directly from HDFS. Only at this point we
+           from a window or directly from HDFS. Only at this point we
            can adjust the file offset */
 #ifdef ISILON_DEBUG
         result = isilonSetObjOffsetByID( id, fd->getOffset() + bytes_taken);
@@ -1637,6 +3194,9 @@ ISILON_LOCAL irods::error isilonReadBuf( struct hdfs_namenode *nn,
 
     *bytes_read = buf_offset; 
 
+    result = isilonStartReadAhead( nn, id, fd);
+    ISILON_ERROR_CHECK_PASS( result);
+
     return result;
 }
 
@@ -1687,6 +3247,356 @@ ISILON_LOCAL irods::error isilonStatPath( isilonConnectionDesc* conn,
     return result;
 } // isilonStatPath
 
+/**
+ * Body of the thread fetching a file while the file is being opened
+ *
+ * Block locations of the file are requested at once. If the file is
+ * small enough, its data are read as well. Errors are not reported
+ * from here: the data are fetched once again when they are read
+ */
+ISILON_LOCAL void isilonEagerFetchWorker( struct hdfs_namenode *nn,
+                                          const char *path,
+                                          isilonEagerFetch *eager)
+{
+    struct hdfs_object *exception = 0;
+    struct hdfs_object *located_blocks = hdfs_getBlockLocations( nn, path, 0,
+                                                                 ISILON_BLOCK_MAP_BATCH_SIZE,
+                                                                 &exception);
+
+    if ( exception || located_blocks->ob_type == H_NULL )
+    {
+        isilonFreeHDFSObjs( 2, &exception, &located_blocks);
+
+        return;
+    }
+
+    isilonBlockMap block_map;
+    struct hdfs_located_blocks *lbs = &located_blocks->ob_val._located_blocks;
+    long long size = lbs->_size;
+
+    eager->block_seq = block_map.update( located_blocks);
+
+    if ( size <= 0 || size > eager->max_size || lbs->_being_written )
+    {
+        return;
+    }
+
+    int status = 0;
+    char *data = (char *)malloc( size);
+
+    if ( !data )
+    {
+        return;
+    }
+
+    if ( !isilonFillBufferFromHDFS( nn, path, &block_map, *eager->io_params,
+                                    data, 0, size, &status).ok() )
+    {
+        free( data);
+
+        return;
+    }
+
+    ISILON_LOG( "\t\tFile %s (%lld bytes) fetched at open", path, size);
+    eager->data = data;
+    eager->size = size;
+}
+
+/**
+ * Fetch block locations and first data (up to 'max_data' bytes) of file
+ * 'path' of 'size' bytes modified at 'mtime'. Returns null if the file cannot be prefetched
+ * (e.g. it is being written)
+ */
+ISILON_LOCAL isilonPrefetchedFilePtr isilonPrefetchFile( struct hdfs_namenode *nn,
+                                                         const isilonIOParams& io_params,
+                                                         const std::string& path,
+                                                         long long size,
+                                                         unsigned long block_size,
+                                                         long long mtime,
+                                                         long long max_data)
+{
+    isilonPrefetchedFilePtr file;
+    struct hdfs_object *exception = 0;
+    struct hdfs_object *located_blocks = hdfs_getBlockLocations( nn, path.c_str(), 0,
+                                                                 ISILON_BLOCK_MAP_BATCH_SIZE,
+                                                                 &exception);
+
+    if ( exception || located_blocks->ob_type == H_NULL
+         || located_blocks->ob_val._located_blocks._being_written )
+    {
+        isilonFreeHDFSObjs( 2, &exception, &located_blocks);
+
+        return file;
+    }
+
+    isilonBlockMap block_map;
+    int status = 0;
+
+    file.reset( new isilonPrefetchedFile());
+    file->nn = nn;
+    file->size = size;
+    file->block_size = block_size;
+    file->mtime = mtime;
+    file->block_seq = block_map.update( located_blocks);
+    file->data_size = std::min( size, max_data);
+
+    if ( file->data_size > 0 )
+    {
+        file->data = (char *)malloc( file->data_size);
+
+        if ( !file->data
+             || !isilonFillBufferFromHDFS( nn, path.c_str(), &block_map, io_params,
+                                           file->data, 0, file->data_size,
+                                           &status).ok() )
+        {
+            free( file->data);
+            file->data = 0;
+            file->data_size = 0;
+        }
+    }
+
+    ISILON_LOG( "\t\tFile %s prefetched (%lld of %lld bytes)", path.c_str(),
+                file->data_size, file->size);
+
+    return file;
+}
+
+/**
+ * Get the number of bytes prefetched from the start of a file
+ * opened through 'conn'
+ */
+ISILON_LOCAL long long isilonGetPrefetchDataSize( isilonConnectionDesc *conn)
+{
+    return std::min( (long long)conn->getIOParams().eager_read_size * 1024,
+                     (long long)conn->getBuffSize());
+}
+
+/**
+ * Prefetch up to 'num' files following 'path' in its directory
+ *
+ * Files being written or prefetched already are skipped
+ */
+ISILON_LOCAL void isilonPrefetchWorker( struct hdfs_namenode *nn,
+                                        isilonIOParams io_params,
+                                        std::string path,
+                                        long long max_data,
+                                        int num)
+{
+    std::string dir, name;
+    struct hdfs_object *exception = 0;
+    struct hdfs_object *dir_list = 0;
+
+    if ( isilonFilePrefetcher::splitPath( path, &dir, &name) )
+    {
+        /* Listing starts after 'name', so it begins with the next files */
+        dir_list = hdfs_getListing( nn, dir.c_str(), name.c_str(), &exception);
+    }
+
+    if ( !dir_list || exception || dir_list->ob_type == H_NULL )
+    {
+        isilonFreeHDFSObjs( 2, &exception, &dir_list);
+        FILE_PREFETCHER.done( ISILON_PREFETCH_WALK);
+
+        return;
+    }
+
+    struct hdfs_directory_listing *listing = &dir_list->ob_val._directory_listing;
+
+    for ( int i = 0; i < listing->_num_files && num > 0; i++ )
+    {
+        struct hdfs_file_status *fstatus = &listing->_files[i]->ob_val._file_status;
+
+        if ( fstatus->_directory )
+        {
+            continue;
+        }
+
+        std::string child = ((dir == "/") ? dir : dir + "/") + fstatus->_file;
+
+        num--;
+
+        if ( FILE_PREFETCHER.begin( child) )
+        {
+            FILE_PREFETCHER.put( child, isilonPrefetchFile( nn, io_params, child,
+                                                            fstatus->_size,
+                                                            fstatus->_block_size,
+                                                            fstatus->_mtime,
+                                                            max_data));
+        }
+    }
+
+    isilonFreeHDFSObjs( 1, &dir_list);
+    FILE_PREFETCHER.done( ISILON_PREFETCH_WALK);
+}
+
+/**
+ * Start prefetch of files following 'path', if its directory is read
+ * file by file
+ */
+ISILON_LOCAL void isilonPrefetchFiles( isilonConnectionDesc *conn,
+                                       const char *path)
+{
+    const isilonIOParams& io_params = conn->getIOParams();
+
+    if ( !FILE_PREFETCHER.opened( path) || !io_params.prefetch_files )
+    {
+        return;
+    }
+
+#ifdef ISILON_NO_CACHED_CONNECTIONS
+    /* Name Node connection is closed at the end of each plugin operation
+       in this mode, so it cannot be used by a background thread */
+    return;
+#endif
+
+    if ( FILE_PREFETCHER.start( ISILON_PREFETCH_WALK, isilonPrefetchWorker,
+                                conn->getNameNode(), io_params, std::string( path),
+                                isilonGetPrefetchDataSize( conn), io_params.prefetch_files) )
+    {
+        ISILON_LOG( "\t\tPrefetch of %d files following %s started",
+                    io_params.prefetch_files, path);
+    }
+}
+
+/**
+ * Prefetch file 'path' which is marked as being prefetched
+ */
+ISILON_LOCAL void isilonRedirectPrefetchWorker( struct hdfs_namenode *nn,
+                                                isilonIOParams io_params,
+                                                std::string path,
+                                                long long max_data)
+{
+    struct hdfs_object *exception = 0;
+    struct hdfs_object *fstat = hdfs_getFileInfo( nn, path.c_str(), &exception);
+    isilonPrefetchedFilePtr file;
+
+    if ( !exception && fstat->ob_type == H_FILE_STATUS
+         && !fstat->ob_val._file_status._directory )
+    {
+        file = isilonPrefetchFile( nn, io_params, path, fstat->ob_val._file_status._size,
+                                   fstat->ob_val._file_status._block_size,
+                                   fstat->ob_val._file_status._mtime, max_data);
+    }
+
+    isilonFreeHDFSObjs( 2, &exception, &fstat);
+    FILE_PREFETCHER.put( path, file);
+    FILE_PREFETCHER.done( ISILON_PREFETCH_REDIRECT);
+}
+
+/**
+ * Start prefetch of file 'path' chosen by redirection, so that
+ * the file is prefetched by the time it is opened
+ */
+ISILON_LOCAL void isilonPrefetchRedirected( isilonConnectionDesc *conn,
+                                            const std::string& path)
+{
+    const isilonIOParams& io_params = conn->getIOParams();
+
+    /* Just like eager reads at open */
+    if ( !io_params.eager_read_size || io_params.read_mode == ISILON_READ_RANDOM )
+    {
+        return;
+    }
+
+#ifdef ISILON_NO_CACHED_CONNECTIONS
+    /* Name Node connection is closed at the end of each plugin operation
+       in this mode, so it cannot be used by a background thread */
+    return;
+#endif
+
+    if ( !FILE_PREFETCHER.begin( path) )
+    {
+        return;
+    }
+
+    if ( FILE_PREFETCHER.start( ISILON_PREFETCH_REDIRECT, isilonRedirectPrefetchWorker,
+                                conn->getNameNode(), io_params, path,
+                                isilonGetPrefetchDataSize( conn)) )
+    {
+        ISILON_LOG( "\t\tPrefetch of %s started", path.c_str());
+    } else
+    {
+        FILE_PREFETCHER.put( path, isilonPrefetchedFilePtr());
+    }
+}
+
+/**
+ * Parse comma-separated access hints of an open. Unknown hints are ignored
+ */
+ISILON_LOCAL int isilonParseAccessHints( const char *hints_str)
+{
+    int hints = ISILON_HINT_NONE;
+
+    if ( !hints_str )
+    {
+        return hints;
+    }
+
+    std::vector<std::string> names;
+
+    irods::string_tokenize( hints_str, ",", names);
+
+    for ( std::vector<std::string>::const_iterator itr = names.begin();
+          itr != names.end(); ++itr )
+    {
+        if ( *itr == "sequential" )
+        {
+            hints |= ISILON_HINT_SEQUENTIAL;
+        } else if ( *itr == "random" )
+        {
+            hints |= ISILON_HINT_RANDOM;
+        } else if ( *itr == "whole" )
+        {
+            hints |= ISILON_HINT_WHOLE;
+        } else if ( *itr == "nocache" )
+        {
+            hints |= ISILON_HINT_NO_CACHE;
+        } else
+        {
+            ISILON_LOG( "\tUnknown access hint \"%s\" is ignored", itr->c_str());
+        }
+    }
+
+    /* Contradicting hints are ignored */
+    if ( (hints & ISILON_HINT_RANDOM) && (hints & (ISILON_HINT_SEQUENTIAL | ISILON_HINT_WHOLE)) )
+    {
+        ISILON_LOG( "\tAccess hint \"random\" contradicts other hints, ignored");
+        hints &= ~ISILON_HINT_RANDOM;
+    }
+
+    return hints;
+}
+
+/**
+ * Override I/O parameters of a file descriptor with access hints of its open
+ */
+ISILON_LOCAL void isilonApplyAccessHints( int hints, isilonIOParams *io_params)
+{
+    if ( hints & (ISILON_HINT_SEQUENTIAL | ISILON_HINT_WHOLE) )
+    {
+        io_params->read_mode = ISILON_READ_SEQUENTIAL;
+        io_params->read_ahead = true;
+    }
+
+    if ( hints & ISILON_HINT_RANDOM )
+    {
+        /* Nothing is fetched beyond the pages a read touches */
+        io_params->read_mode = ISILON_READ_RANDOM;
+        io_params->read_ahead = false;
+        io_params->eager_read_size = 0;
+    }
+
+    if ( hints & ISILON_HINT_WHOLE )
+    {
+        io_params->eager_read_size = ISILON_MAX_EAGER_READ_SIZE;
+    }
+
+    if ( hints & ISILON_HINT_NO_CACHE )
+    {
+        io_params->block_cache_size = 0;
+    }
+}
+
 /**
  * Open HDFS file and return corresponding ID
  */
@@ -1694,6 +3604,7 @@ ISILON_LOCAL irods::error isilonOpenFile( isilonConnectionDesc *conn,
                                           const char           *path,
                                           int                  flags,
                                           int                  mode,
+                                          int                  hints,
                                           int                  *file_id,
                                           int                  *status)
 {
@@ -1707,15 +3618,89 @@ ISILON_LOCAL irods::error isilonOpenFile( isilonConnectionDesc *conn,
     
     struct hdfs_namenode *nn = conn->getNameNode();
     struct hdfs_object *fstat = 0;
-    
-    /* Check if the file exists on the filesystem */
-    result = isilonGetHDFSFileInfo( nn, path, &fstat, status);
+    isilonIOParams io_params = conn->getIOParams();
+    unsigned long buff_size = conn->getBuffSize();
+    isilonEagerFetch eager;
+    boost::thread eager_thread;
+    isilonPrefetchedFilePtr prefetched;
+    long long file_size = 0;
+    unsigned long block_size = 0;
+    long long mtime = 0;
+
+    if ( flags == O_RDONLY && hints != ISILON_HINT_NONE )
+    {
+        ISILON_LOG( "\tAccess hints of %s: 0x%x", path, hints);
+        isilonApplyAccessHints( hints, &io_params);
 
-    if ( !result.ok() )
+        /* The file size is not known yet, so the whole file may be
+           fetched at open up to the biggest buffer */
+        if ( hints & ISILON_HINT_WHOLE )
+        {
+            buff_size = ISILON_MAX_HINT_BUFF_SIZE;
+        }
+    }
+
+    if ( flags == O_RDONLY && io_params.read_mode != ISILON_READ_RANDOM )
     {
-        isilonFreeHDFSObjs( 1, &fstat);
+        prefetched = FILE_PREFETCHER.take( path);
+        isilonPrefetchFiles( conn, path);
+    }
 
-        return PASS( result);
+    /* Files with the same path may be prefetched from another cluster */
+    if ( prefetched && prefetched->nn != nn )
+    {
+        prefetched.reset();
+    }
+
+    if ( prefetched )
+    {
+        ISILON_LOG( "\tFile %s was prefetched", path);
+        file_size = prefetched->size;
+        block_size = prefetched->block_size;
+        mtime = prefetched->mtime;
+    } else
+    {
+        /* Block locations (and data of a small file) are requested
+           along with file information, saving round trips before
+           the first read */
+        if ( flags == O_RDONLY && io_params.eager_read_size
+             && io_params.read_mode != ISILON_READ_RANDOM )
+        {
+            eager.io_params = &io_params;
+            eager.max_size = std::min( (long long)io_params.eager_read_size * 1024,
+                                       (long long)buff_size);
+            eager_thread = boost::thread( isilonEagerFetchWorker, nn, path, &eager);
+        }
+
+        /* Check if the file exists on the filesystem */
+        result = isilonGetHDFSFileInfo( nn, path, &fstat, status);
+
+        if ( eager_thread.joinable() )
+        {
+            eager_thread.join();
+        }
+
+        if ( !result.ok() )
+        {
+            isilonFreeHDFSObjs( 1, &fstat);
+
+            return PASS( result);
+        }
+
+        file_size = fstat->ob_val._file_status._size;
+        block_size = fstat->ob_val._file_status._block_size;
+        mtime = fstat->ob_val._file_status._mtime;
+    }
+
+    /* A file read as a whole gets a buffer fitting it (rounded up to megabytes),
+       so that it is read by a single buffer fill */
+    if ( flags == O_RDONLY && (hints & ISILON_HINT_WHOLE) )
+    {
+        const unsigned long mb = 1024 * 1024;
+
+        buff_size = std::min( (unsigned long)std::max( file_size, 1LL) + mb - 1,
+                              ISILON_MAX_HINT_BUFF_SIZE) / mb * mb;
+        ISILON_LOG( "\tBuffer size of %s: %lu bytes", path, buff_size);
     }
 
     if ( ((flags & O_RDWR) || (flags & O_WRONLY)) && (flags & O_TRUNC) )
@@ -1743,8 +3728,7 @@ ISILON_LOCAL irods::error isilonOpenFile( isilonConnectionDesc *conn,
             }
         } else if ( flags == O_RDONLY )
         {
-            *file_id = isilonNewFileDesc( ISILON_MODE_READ, path,
-                                          conn->getBuffSize(), 0);
+            *file_id = isilonNewFileDesc( ISILON_MODE_READ, path, buff_size, 0);
         } else
         {
             *file_id = isilonNewFileDesc( ISILON_MODE_UNKNOWN, path,
@@ -1758,7 +3742,39 @@ ISILON_LOCAL irods::error isilonOpenFile( isilonConnectionDesc *conn,
            to access file desctiptor structure after creation directly (without mapping
            its ID to the pointer) */
         isilonGetFileDescByID( *file_id, &fd);
-        fd->setFileSize( fstat->ob_val._file_status._size);
+        fd->setFileSize( file_size);
+        fd->setBlockSize( block_size);
+        fd->setIOParams( io_params);
+
+        if ( flags == O_RDONLY )
+        {
+            fd->setWrittenData( WRITE_CACHE.get( path, file_size, mtime));
+        }
+
+        if ( prefetched && prefetched->block_seq )
+        {
+            fd->getBlockMap()->update( prefetched->block_seq);
+        } else if ( eager.block_seq )
+        {
+            fd->getBlockMap()->update( eager.block_seq);
+        }
+
+        /* Data fetched at open (or before it) become the first read window */
+        if ( prefetched && prefetched->data
+             && fd->beginWindow( 0, 0, prefetched->data_size).ok() )
+        {
+            isilonReadWindow *w = fd->getWindow( 0);
+
+            memcpy( w->data + w->hist_len, prefetched->data, prefetched->data_size);
+            fd->completeWindow( 0, true);
+        } else if ( eager.data && eager.size == fd->getFileSize()
+                    && fd->beginWindow( 0, 0, eager.size).ok() )
+        {
+            isilonReadWindow *w = fd->getWindow( 0);
+
+            memcpy( w->data + w->hist_len, eager.data, eager.size);
+            fd->completeWindow( 0, true);
+        }
     }
 
     isilonFreeHDFSObjs( 1, &fstat);
@@ -1906,7 +3922,7 @@ ISILON_LOCAL irods::error isilonCopyFromArch( irods::resource_plugin_context& _c
         result = isilonOpenFile( conn, fco->physical_path().c_str(), O_RDONLY,
                                  /* Passing zero as a mode, since this parameter
                                     is not used under "O_RDONLY" flag */
-                                 0,
+                                 0, ISILON_HINT_SEQUENTIAL | ISILON_HINT_NO_CACHE,
                                  &file_id, &status); 
         ISILON_ERROR_CHECK_PASS( result);
 
@@ -1993,11 +4009,15 @@ ISILON_LOCAL irods::error isilonRedirectCreate( irods::plugin_property_map&   _p
 
 /**
  * Calculate vote for opening particular object on this resource
+ *
+ * If 'prefetch' is set and the object is going to be opened here,
+ * its replica file is prefetched meanwhile
  */
 ISILON_LOCAL irods::error isilonRedirectOpen( irods::plugin_property_map&   _prop_map,
                                               irods::file_object_ptr        _file_obj,
                                               const std::string&            _resc_name,
                                               const std::string&            _curr_host,
+                                              bool                          _prefetch,
                                               float&                        _out_vote)
 {
     irods::error result = SUCCESS();
@@ -2026,6 +4046,9 @@ ISILON_LOCAL irods::error isilonRedirectOpen( irods::plugin_property_map&   _pro
     /* make some flags to clarify decision making */
     bool need_repl = (_file_obj->repl_requested() > -1);
 
+    /* physical path of the replica voted for */
+    std::string phy_path;
+
     /* set up variables for iteration */
     std::vector<irods::physical_object> objs = _file_obj->replicas();
     std::vector<irods::physical_object>::iterator itr = objs.begin();
@@ -2077,6 +4100,28 @@ ISILON_LOCAL irods::error isilonRedirectOpen( irods::plugin_property_map&   _pro
                 _out_vote = 1.0;
             }
         }
+
+        if ( _out_vote == 1.0 && phy_path.empty() )
+        {
+            phy_path = itr->path();
+        }
+    }
+
+    std::string location;
+
+    _prop_map.get<std::string>( irods::RESOURCE_LOCATION, location);
+
+    /* The object is opened by this agent only if the resource is local */
+    if ( _prefetch && !phy_path.empty() && location == _curr_host )
+    {
+        isilonConnectionDesc *conn = 0;
+        std::string full_path;
+
+        if ( isilonGenerateFullPath( _prop_map, phy_path, full_path).ok()
+             && isilonGetConnection( _prop_map, &conn).ok() )
+        {
+            isilonPrefetchRedirected( conn, full_path);
+        }
     }
 
     ISILON_LOG( "\tRedirect Open completed with vote: %4.2f", _out_vote);
@@ -2262,9 +4307,11 @@ irods::error isilonFileOpenPlugin( irods::resource_plugin_context& _ctx)
     ISILON_GET_CONNECTION( _ctx.prop_map(), &conn);
 
     int status = 0, file_id = 0;
+    int hints = isilonParseAccessHints( getValByKey( &fco->cond_input(),
+                                                     ISILON_ACCESS_HINT_KEY.c_str()));
    
     result = isilonOpenFile( conn, fco->physical_path().c_str(),
-                             fco->flags(), fco->mode(), &file_id, &status);
+                             fco->flags(), fco->mode(), hints, &file_id, &status);
 
     if ( !result.ok() )
     {
@@ -2393,6 +4440,8 @@ irods::error isilonFileWritePlugin( irods::resource_plugin_context& _ctx,
         fd->setLastBlock( last_block);
         fd->setMode( ISILON_MODE_WRITE);
 #endif 
+        fd->setBuffSize( isilonGetWriteBuffSize( conn, last_block));
+        isilonSetupFileWrite( conn, fco->file_descriptor());
     }
 
     result = isilonWriteFile( conn, fco->file_descriptor(), _buf, _len, &status);
@@ -2604,12 +4653,13 @@ irods::error isilonFileLseekPlugin( irods::resource_plugin_context& _ctx,
         return PASS( result);
     }
 
-    /* Check if we should reload a buffer */
+    /* Check if we should reload a buffer. Read windows are addressed by
+       file offset, so files opened in READ mode need no adjustment */
     long long delta_in_file = offset - fd->getOffset();
     int buff_offset = fd->getBuffOffset();
     int new_buff_offset = 0;
 
-    if ( buff_offset )
+    if ( buff_offset && fd->getMode() != ISILON_MODE_READ )
     {
         if ( delta_in_file > 0 )
         {
@@ -2932,6 +4982,8 @@ irods::error isilonFileRenamePlugin( irods::resource_plugin_context& _ctx,
     int status = 0;
 
     ISILON_LOG( "\tRenaming file");
+    isilonForgetFileData( path);
+    isilonForgetFileData( new_path);
     oper_status = hdfs_rename( nn, path, new_path.c_str(), &exception);
     result = ISILON_ASSERT_ERROR( !exception, ISILON_ERR_RENAME_FAIL,
                                   exception ? hdfs_exception_get_message( exception) : 0);
@@ -3092,7 +5144,9 @@ irods::error isilonRedirectPlugin( irods::resource_plugin_context& _ctx,
     {
         /* call redirect determination for 'get' operation */
         result = isilonRedirectOpen( _ctx.prop_map(), file_obj, resc_name,
-                                     (*_curr_host), (*_out_vote));
+                                     (*_curr_host),
+                                     irods::OPEN_OPERATION == (*_opr),
+                                     (*_out_vote));
     } else if( irods::CREATE_OPERATION == (*_opr) )
     {
         /* call redirect determination for 'create' operation */
@@ -3161,13 +5215,31 @@ class isilon_resource : public irods::resource
             unsigned long port_num = 0;
             unsigned long buf_size = 0;
 
+            isilonIOParams io_params;
+
             isilonParseConnectionProps( properties_, host_name, &port_num,
                                         user_name, &buf_size);
+            isilonParseIOParams( properties_, &io_params);
 
             properties_[ISILON_HOST_KEY] = host_name;
             properties_[ISILON_PORT_KEY] = port_num;
             properties_[ISILON_USER_KEY] = user_name;
             properties_[ISILON_BUFSIZE_KEY] = buf_size;
+            properties_[ISILON_READ_AHEAD_KEY] = io_params.read_ahead;
+            properties_[ISILON_READ_THREADS_KEY] = io_params.read_threads;
+            properties_[ISILON_READ_MODE_KEY] = io_params.read_mode;
+            properties_[ISILON_BLOCK_CACHE_KEY] = io_params.block_cache_size;
+            properties_[ISILON_READ_HISTORY_KEY] = io_params.read_history;
+            properties_[ISILON_VERIFY_CHECKSUMS_KEY] = io_params.verify_checksums;
+            properties_[ISILON_HEDGED_READS_KEY] = io_params.hedged_reads;
+            properties_[ISILON_HEDGE_PERCENTILE_KEY] = io_params.hedge_percentile;
+            properties_[ISILON_EAGER_READ_SIZE_KEY] = io_params.eager_read_size;
+            properties_[ISILON_ALIGN_FILLS_KEY] = io_params.align_fills;
+            properties_[ISILON_PREFETCH_FILES_KEY] = io_params.prefetch_files;
+            properties_[ISILON_WRITE_CACHE_SIZE_KEY] = io_params.write_cache_size;
+            properties_[ISILON_WRITE_BUFFERS_KEY] = io_params.write_buffers;
+            properties_[ISILON_ADD_BLOCK_AHEAD_KEY] = io_params.add_block_ahead;
+            properties_[ISILON_WRITE_BUF_SIZE_KEY] = io_params.write_buf_size;
 
             /* Add start and stop operations */
             set_start_operation( "isilonStartOperation" );
@@ -28,6 +28,19 @@ extern "C"
 // =-=-=-=-=-=-=-
 // STL includes
 #include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+// =-=-=-=-=-=-=-
+// boost includes
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/shared_ptr.hpp>
 
 // =-=-=-=-=-=-=-
 // System includes
@@ -37,11 +50,29 @@ extern "C"
 #include <sys/syscall.h>
 #endif
 #endif
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
 
 static const std::string ISILON_HOST_KEY( "isi_host");
 static const std::string ISILON_PORT_KEY( "isi_port");
 static const std::string ISILON_USER_KEY( "isi_user");
 static const std::string ISILON_BUFSIZE_KEY( "isi_buf_size");
+static const std::string ISILON_READ_AHEAD_KEY( "isi_read_ahead");
+static const std::string ISILON_READ_THREADS_KEY( "isi_read_threads");
+static const std::string ISILON_READ_MODE_KEY( "isi_read_mode");
+static const std::string ISILON_BLOCK_CACHE_KEY( "isi_block_cache_size");
+static const std::string ISILON_READ_HISTORY_KEY( "isi_read_history");
+static const std::string ISILON_VERIFY_CHECKSUMS_KEY( "isi_verify_checksums");
+static const std::string ISILON_HEDGED_READS_KEY( "isi_hedged_reads");
+static const std::string ISILON_HEDGE_PERCENTILE_KEY( "isi_hedge_percentile");
+static const std::string ISILON_EAGER_READ_SIZE_KEY( "isi_eager_read_size");
+static const std::string ISILON_ALIGN_FILLS_KEY( "isi_align_fills");
+static const std::string ISILON_PREFETCH_FILES_KEY( "isi_prefetch_files");
+static const std::string ISILON_WRITE_CACHE_SIZE_KEY( "isi_write_cache_size");
+static const std::string ISILON_WRITE_BUFFERS_KEY( "isi_write_buffers");
+static const std::string ISILON_ADD_BLOCK_AHEAD_KEY( "isi_add_block_ahead");
+static const std::string ISILON_WRITE_BUF_SIZE_KEY( "isi_write_buf_size");
 
 #define ISILON_LOCAL static inline
 
@@ -158,6 +189,7 @@ enum isilonErrorType
     ISILON_ERR_LOCAL_FILE_OPEN,
     ISILON_ERR_LOCAL_FILE_STAT,
     ISILON_ERR_REGULAR_FILE_EXPECTED,
+    ISILON_ERR_ABANDON_BLOCK_FAIL,
     ISILON_ERR_ERROR_TYPES_NUM
 };
 
@@ -205,6 +237,7 @@ typedef struct isilonErrMesg
 #define ISILON_ERR_CODE_HDFS_ADD_BLOCK_FAIL                        -15000022
 #define ISILON_ERR_CODE_SETTING_LAST_BLOCK_FAIL                    -15000023
 #define ISILON_ERR_CODE_REGULAR_FILE_EXPECTED                      -15000024
+#define ISILON_ERR_CODE_HDFS_ABANDON_BLOCK_FAIL                    -15000025
 
 /**
  * The error codes below signal about general fail of the resource
@@ -389,7 +422,10 @@ const isilonErrMesg isilonErrMesgList[ISILON_ERR_ERROR_TYPES_NUM] =
                           ISILON_ERR_NUM( ISILON_ERR_LOCAL_FILE_STAT)},
                          {ISILON_ERR_CODE_REGULAR_FILE_EXPECTED,
                           "\"%s\" is not a regular file"
-                          ISILON_ERR_NUM( ISILON_ERR_REGULAR_FILE_EXPECTED)}};
+                          ISILON_ERR_NUM( ISILON_ERR_REGULAR_FILE_EXPECTED)},
+                         {ISILON_ERR_CODE_HDFS_ABANDON_BLOCK_FAIL,
+                          "Error abandoning HDFS block: %s"
+                          ISILON_ERR_NUM( ISILON_ERR_ABANDON_BLOCK_FAIL)}};
 
 #ifdef ISILON_DEBUG
 /**
@@ -445,206 +481,2574 @@ typedef class isilonObjectDesc
 
         long long getOffset() { return offset; }
         void setOffset( long long new_offset) { offset = new_offset; }
-        std::string getPath() { return path; }
+        const std::string& getPath() { return path; }
 } isilonObjectDesc;
 
-/* Class representing a file */
-typedef class isilonFileDesc : public isilonObjectDesc
+/* Default and maximum number of blocks fetched concurrently
+   by a single buffer fill */
+#define ISILON_DEFAULT_READ_THREADS 4
+#define ISILON_MAX_READ_THREADS 16
+
+/* Default and maximum size (in megabytes) of the process-wide
+   block cache */
+#define ISILON_DEFAULT_BLOCK_CACHE_SIZE 128
+#define ISILON_MAX_BLOCK_CACHE_SIZE 4096
+
+/* Default percentile of read latencies after which a read is hedged */
+#define ISILON_DEFAULT_HEDGE_PERCENTILE 95
+
+/* Default and maximum size (in kilobytes) of read window history */
+#define ISILON_DEFAULT_READ_HISTORY 1024
+#define ISILON_MAX_READ_HISTORY (64 * 1024)
+
+/* Default and maximum size (in kilobytes) of files fetched as a whole
+   when opened for reading */
+#define ISILON_DEFAULT_EAGER_READ_SIZE 1024
+#define ISILON_MAX_EAGER_READ_SIZE (64 * 1024)
+
+#define ISILON_DEFAULT_PREFETCH_FILES 4
+#define ISILON_MAX_PREFETCH_FILES 16
+
+#define ISILON_MAX_WRITE_CACHE_SIZE 4096
+
+#define ISILON_MAX_WRITE_BUFFERS 4
+
+#define ISILON_MAX_WRITE_BUF_SIZE 256
+
+/* How files opened for reading are buffered */
+typedef enum isilonReadMode
+{
+    /* Large read windows, optionally filled in background */
+    ISILON_READ_SEQUENTIAL,
+    /* Small pages fetched on demand and kept in LRU order */
+    ISILON_READ_RANDOM
+} isilonReadMode;
+
+/**
+ * Resource-level I/O tuning parameters
+ */
+typedef struct isilonIOParams
+{
+    isilonReadMode read_mode;
+    /* Fill the next read window in background while the
+       current one is consumed */
+    bool read_ahead;
+    /* Maximum number of blocks fetched concurrently by a single
+       buffer fill */
+    int read_threads;
+    /* Size (in megabytes) of the process-wide block cache */
+    int block_cache_size;
+    /* Number of kilobytes preceding a window a new window
+       fill keeps from the previous data */
+    int read_history;
+    /* Verify HDFS checksums of data received from Data Nodes */
+    bool verify_checksums;
+    /* Request a block from another location if the first one
+       is slower than most of the recent reads */
+    bool hedged_reads;
+    /* Percentile of recent read latencies after which a read
+       is hedged */
+    int hedge_percentile;
+    /* Files up to this size (in kilobytes) are fetched as a whole
+       when opened for reading */
+    int eager_read_size;
+    /* End read window fills at HDFS block boundaries */
+    bool align_fills;
+    /* Number of files following the one opened for reading (in directory
+       listing order) which are prefetched while files of a directory are
+       read one after another */
+    int prefetch_files;
+    /* Size (in megabytes) of the process-wide cache of data written
+       to files. The last data written to a file are kept there after
+       the file is closed */
+    int write_cache_size;
+    /* Number of write buffers of a file. With more than one, full
+       buffers are committed in background */
+    int write_buffers;
+    /* Request the block for the next write buffer while the current
+       one is written */
+    bool add_block_ahead;
+    /* Size (in megabytes) of write buffers. Each full buffer is committed
+       as a separate block. 0 means the size of read buffers */
+    int write_buf_size;
+} isilonIOParams;
+
+/* Key of iRODS open options (condInput) holding comma-separated access
+   hints of a single open, e.g. "isi_access_hint=whole,nocache" */
+static const std::string ISILON_ACCESS_HINT_KEY( "isi_access_hint");
+
+/**
+ * Access hints of a single open. Override resource-level I/O parameters
+ * for the file descriptor being opened
+ */
+typedef enum isilonAccessHint
+{
+    ISILON_HINT_NONE = 0,
+    /* The file is read from the beginning to the end */
+    ISILON_HINT_SEQUENTIAL = 1 << 0,
+    /* The file is read at random offsets */
+    ISILON_HINT_RANDOM = 1 << 1,
+    /* The whole file is read, so it is buffered as a whole */
+    ISILON_HINT_WHOLE = 1 << 2,
+    /* Data read are not going to be read again by other descriptors,
+       so they bypass the block cache */
+    ISILON_HINT_NO_CACHE = 1 << 3
+} isilonAccessHint;
+
+/* The biggest read buffer (in bytes) "whole" access hint may request */
+#define ISILON_MAX_HINT_BUFF_SIZE (256UL * 1024 * 1024)
+
+/* Amount of file data (starting from the requested offset) which block
+   locations are requested for, when block location cache has no
+   information about the requested region */
+#define ISILON_BLOCK_MAP_BATCH_SIZE (1024LL * 1024 * 1024)
+
+/* Sequence of located blocks shared between readers of the same file
+   descriptor. Freed when the last reader releases it */
+typedef boost::shared_ptr<struct hdfs_object> isilonBlockSeqPtr;
+
+/**
+ * Cache of block locations of a file
+ *
+ * Keeps the last block sequence obtained from Name Node, so that
+ * subsequent reads of the region covered by the sequence do not
+ * require Name Node round trips
+ */
+typedef class isilonBlockMap
 {
     private:
-        /* Mode in which a file was opened */
-        isilonFileMode mode;
-        /* Read or write buffer. The type of the buffer depends on 
-           'mode' in which a file is opened. Memory for the buffer should
-           be allocated on first demand. We don't allocate it on object creation */
-        char *buff;
-        /* Buffer size. For files opened in READ mode it represents a
-           read buffer size. For files open in WRITE mode it represents
-           a write buffer size */
-        unsigned long buff_size;
-        unsigned long buff_offset;
-        long long file_size;
-        /* Last block that needs to be filled, when a file is opened
-           in append mode */
-        struct hdfs_object *last_block;
+        boost::mutex mutex;
+        isilonBlockSeqPtr block_seq;
+        /* File region covered by the sequence */
+        long long begin;
+        long long end;
 
     public:
-        isilonFileDesc( isilonFileMode mode, const char *path,
-                        unsigned long buff_size, struct hdfs_object *last_block) :
-            isilonObjectDesc( path), buff( 0), buff_offset( 0), file_size( 0)
+        isilonBlockMap() : begin( 0), end( 0) {}
+
+        /**
+         * Return the cached sequence if it covers 'len' bytes from 'offset'.
+         * Otherwise return an empty pointer
+         */
+        isilonBlockSeqPtr lookup( long long offset, long long len)
         {
-            this->mode = mode;
-            this->buff_size = buff_size;
-            this->last_block = last_block;
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            if ( block_seq && offset >= begin && offset + len <= end )
+            {
+                return block_seq;
+            }
+
+            return isilonBlockSeqPtr();
         }
 
-        ~isilonFileDesc( )
+        /**
+         * Replace the cached sequence. The map takes ownership
+         * of 'located_blocks'
+         */
+        isilonBlockSeqPtr update( struct hdfs_object *located_blocks)
         {
-            if ( buff )
+            return update( isilonBlockSeqPtr( located_blocks, hdfs_object_free));
+        }
+
+        /* Replace the cached sequence with a sequence shared with another map */
+        isilonBlockSeqPtr update( isilonBlockSeqPtr new_seq)
+        {
+            struct hdfs_located_blocks *lbs = &new_seq->ob_val._located_blocks;
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            block_seq = new_seq;
+            begin = end = 0;
+
+            if ( lbs->_num_blocks )
             {
-                free( buff);
+                struct hdfs_located_block *first = &lbs->_blocks[0]->ob_val._located_block;
+
+                begin = first->_offset;
+                end = first->_offset;
+
+                /* Stop at the first gap. Isilon may return redundant blocks
+                   at the end of the sequence, they are not taken into account */
+                for ( int i = 0; i < lbs->_num_blocks; i++ )
+                {
+                    struct hdfs_located_block *lb = &lbs->_blocks[i]->ob_val._located_block;
+
+                    if ( lb->_offset != end )
+                    {
+                        break;
+                    }
+
+                    end += lb->_len;
+                }
             }
 
-            if ( last_block )
+            return new_seq;
+        }
+
+        void invalidate()
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            block_seq.reset();
+            begin = end = 0;
+        }
+} isilonBlockMap;
+
+/* Contents of an HDFS block kept by the block cache */
+typedef struct isilonCachedBlock
+{
+    char *data;
+    int64_t len;
+    /* Not set while the block is being loaded */
+    bool ready;
+
+    isilonCachedBlock( int64_t len) : len( len), ready( false)
+    {
+        data = (char *)malloc( len);
+    }
+
+    ~isilonCachedBlock()
+    {
+        free( data);
+    }
+
+    isilonCachedBlock( const isilonCachedBlock&) = delete;
+    isilonCachedBlock& operator=( const isilonCachedBlock&) = delete;
+} isilonCachedBlock;
+
+typedef boost::shared_ptr<isilonCachedBlock> isilonCachedBlockPtr;
+
+/**
+ * Process-wide cache of HDFS blocks
+ *
+ * Lets descriptors of the same file (e.g. opened by parallel transfer
+ * threads) share data fetched from Data Nodes. Blocks are keyed by file
+ * path, block ID and generation stamp, and evicted in LRU order when
+ * the cache grows over its capacity. A block is loaded by one thread
+ * only, other threads needing the block wait for the load
+ */
+typedef class isilonBlockCache
+{
+    private:
+        typedef struct isilonBlockCacheEntry
+        {
+            isilonCachedBlockPtr block;
+            /* Position in LRU list. Valid for ready blocks only */
+            std::list<std::string>::iterator lru_pos;
+        } isilonBlockCacheEntry;
+
+        boost::mutex mutex;
+        boost::condition_variable cond;
+        unsigned long long capacity;
+        /* Size of ready blocks */
+        unsigned long long size;
+        /* Keys of ready blocks, most recently used go first */
+        std::list<std::string> lru;
+        std::unordered_map<std::string, isilonBlockCacheEntry> blocks;
+
+        /* Must be called with the mutex held */
+        void eraseEntry( std::unordered_map<std::string, isilonBlockCacheEntry>::iterator it)
+        {
+            if ( it->second.block->ready )
             {
-                hdfs_object_free( last_block);
+                size -= it->second.block->len;
+                lru.erase( it->second.lru_pos);
             }
+
+            blocks.erase( it);
         }
 
-        isilonFileMode getMode() { return mode; }
+    public:
+        isilonBlockCache() : capacity( 0), size( 0) {}
 
-#ifdef ISILON_DEBUG
-        irods::error
-#else
-        void
-#endif
-        setMode( isilonFileMode mode)
+        /**
+         * Let the cache grow up to 'capacity' bytes. The biggest capacity
+         * requested so far is used
+         */
+        void reserve( unsigned long long capacity)
         {
-#ifdef ISILON_DEBUG
-            irods::error result = SUCCESS();
+            boost::lock_guard<boost::mutex> lock( mutex);
 
-            /* Changing mode is allowed for files
-               opened in UNKNOWN mode only */
-            result = ISILON_ASSERT_ERROR( this->mode == ISILON_MODE_UNKNOWN,
-                                          ISILON_ERR_UNEXPECTED_MODE,
-                                          this->mode, ISILON_MODE_UNKNOWN);
-            ISILON_ERROR_CHECK( result);
-#endif
-            this->mode = mode;
+            if ( capacity > this->capacity )
+            {
+                this->capacity = capacity;
+            }
+        }
 
-#ifdef ISILON_DEBUG
-            return result;
-#endif
+        bool isEnabled()
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            return capacity > 0;
         }
 
-        unsigned long getBuffSize()
+        /**
+         * Get the block addressed by 'key' holding at least 'len' bytes
+         *
+         * Waits if the block is being loaded by another thread. If the
+         * block is not cached and 'load' is set, a new block is returned
+         * with 'loader' set. The caller should fill it and publish it with
+         * "completeLoad". Otherwise an empty pointer is returned
+         */
+        isilonCachedBlockPtr acquire( const std::string& key, int64_t len,
+                                      bool load, bool *loader)
         {
-            if ( last_block )
+            boost::unique_lock<boost::mutex> lock( mutex);
+            auto it = blocks.find( key);
+
+            *loader = false;
+
+            while ( it != blocks.end() && !it->second.block->ready )
             {
-                return buff_size - last_block->ob_val._located_block._len;
-            } else
+                cond.wait( lock);
+                it = blocks.find( key);
+            }
+
+            if ( it != blocks.end() )
             {
-                return buff_size;
+                if ( it->second.block->len >= len )
+                {
+                    lru.splice( lru.begin(), lru, it->second.lru_pos);
+
+                    return it->second.block;
+                }
+
+                /* The block has grown since it was cached */
+                eraseEntry( it);
             }
-        }
 
-        unsigned long getBuffOffset() { return buff_offset; }
-        long long getFileSize() { return file_size; }
-        void setFileSize( long long file_size) { this->file_size = file_size; }
-        struct hdfs_object *getLastBlock() { return last_block; }
-        void seekBuff( int offset) { buff_offset = offset; }
+            if ( !load || (unsigned long long)len > capacity )
+            {
+                return isilonCachedBlockPtr();
+            }
 
-#ifdef ISILON_DEBUG
-        irods::error
-#else
-        void
-#endif
-        setLastBlock( struct hdfs_object *last_block)
-        {
-#ifdef ISILON_DEBUG
-            irods::error result = SUCCESS();
+            isilonCachedBlockPtr block( new isilonCachedBlock( len));
 
-            result = ISILON_ASSERT_ERROR( !this->last_block
-                                          && (this->mode == ISILON_MODE_UNKNOWN),
-                                          ISILON_ERR_SETTING_LAST_BLOCK_FAIL);
-            ISILON_ERROR_CHECK( result);
-#endif
-            this->last_block = last_block;
-            
-#ifdef ISILON_DEBUG
-            return result;
-#endif
+            if ( !block->data )
+            {
+                return isilonCachedBlockPtr();
+            }
+
+            blocks[key].block = block;
+            *loader = true;
+
+            return block;
         }
 
-        void releaseLastBlock()
+        /**
+         * Finish the load of a block returned by "acquire". A failed
+         * block is dropped, so that a next reader tries to load it again
+         */
+        void completeLoad( const std::string& key, bool is_ok)
         {
-            if ( last_block )
+            boost::lock_guard<boost::mutex> lock( mutex);
+            auto it = blocks.find( key);
+
+            if ( it != blocks.end() )
             {
-                hdfs_object_free( last_block);
+                if ( is_ok )
+                {
+                    it->second.block->ready = true;
+                    size += it->second.block->len;
+                    lru.push_front( key);
+                    it->second.lru_pos = lru.begin();
+                } else
+                {
+                    eraseEntry( it);
+                }
             }
 
-            last_block = 0;
+            while ( size > capacity )
+            {
+                eraseEntry( blocks.find( lru.back()));
+            }
+
+            cond.notify_all();
         }
+} isilonBlockCache;
 
-        irods::error flushBuff( const char **output_buff)
+/* Number of recent block reads latency percentiles are computed over */
+#define ISILON_LATENCY_SAMPLES_NUM 256
+
+/* Minimal number of samples needed to compute a percentile */
+#define ISILON_LATENCY_MIN_SAMPLES 16
+
+/**
+ * Process-wide statistics of block read latencies
+ *
+ * Reads differ in size, so samples are kept as seconds per megabyte.
+ * Reads shorter than a megabyte are counted as a megabyte long,
+ * since their time is dominated by request latency
+ */
+typedef class isilonLatencyTracker
+{
+    private:
+        boost::mutex mutex;
+        std::vector<double> samples;
+        /* Index of the sample to be replaced next */
+        size_t next;
+
+    public:
+        isilonLatencyTracker() : next( 0) {}
+
+        static double perMb( int64_t len)
         {
-            irods::error result = SUCCESS();
+            double mb = (double)len / (1024 * 1024);
+
+            return mb > 1 ? mb : 1;
+        }
+
+        void add( double elapsed, int64_t len)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+            double sample = elapsed / perMb( len);
 
-            if ( mode == ISILON_MODE_READ )
+            if ( samples.size() < ISILON_LATENCY_SAMPLES_NUM )
             {
-                buff_offset = buff_size;
+                samples.push_back( sample);
             } else
             {
-                result = ISILON_ASSERT_ERROR( mode == ISILON_MODE_WRITE,
-                                              ISILON_ERR_MODE_NOT_SUPPORTED);
+                samples[next] = sample;
+                next = (next + 1) % ISILON_LATENCY_SAMPLES_NUM;
+            }
+        }
+
+        /**
+         * Get time in which 'pct' percent of recent reads of 'len' bytes
+         * completed. Negative if there are not enough samples yet
+         */
+        double percentile( int pct, int64_t len)
+        {
+            std::vector<double> sorted;
 
-                if ( !result.ok() )
+            {
+                boost::lock_guard<boost::mutex> lock( mutex);
+
+                if ( samples.size() < ISILON_LATENCY_MIN_SAMPLES )
                 {
-                    return result;
+                    return -1;
                 }
 
-                buff_offset = 0;
+                sorted = samples;
             }
 
-            *output_buff = buff;
+            size_t n = (sorted.size() - 1) * pct / 100;
 
-            return result;
+            std::nth_element( sorted.begin(), sorted.begin() + n, sorted.end());
+
+            return sorted[n] * perMb( len);
         }
+} isilonLatencyTracker;
 
-        irods::error writeToBuff( const char *buf, unsigned long offset,
-                                  unsigned long len)
+/* Weight of a new sample in Data Node statistics */
+#define ISILON_NODE_EWMA_WEIGHT 0.2
+
+/* Seconds after which statistics of a Data Node are considered
+   outdated, so that a node avoided because of failures gets
+   a chance again */
+#define ISILON_NODE_STATS_TTL 60
+
+/* Sample (seconds per megabyte) a failed transfer counts as */
+#define ISILON_NODE_FAILURE_PENALTY 10.0
+
+/* Name Node order of block locations is kept unless the first location
+   is this many times slower than the best one */
+#define ISILON_NODE_SCORE_TOLERANCE 1.5
+
+/* ... and slower by at least this many seconds per megabyte, so that
+   jitter of fast nodes does not reorder locations */
+#define ISILON_NODE_SCORE_MIN_DIFF 0.005
+
+/**
+ * Process-wide statistics of Data Node performance
+ *
+ * For each Data Node (keyed by "host:port") an exponentially weighted
+ * moving average of transfer time per megabyte is kept. Both reads
+ * and writes contribute, failed transfers count as very slow ones
+ */
+typedef class isilonNodeStats
+{
+    private:
+        typedef struct isilonNodeScore
         {
-            irods::error result = SUCCESS();
+            /* Seconds per megabyte */
+            double ewma;
+            time_t updated;
+        } isilonNodeScore;
 
-            result = ISILON_ASSERT_ERROR( mode == ISILON_MODE_WRITE,
-                                          ISILON_ERR_FILE_NOT_OPEN_FOR_WRITE);
-            ISILON_ERROR_CHECK( result);
+        boost::mutex mutex;
+        std::unordered_map<std::string, isilonNodeScore> nodes;
 
-            /* Allocate buffer memory if not done yet */
-            if ( !buff )
+        void addSample( const std::string& addr, double sample)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+            time_t now = time( 0);
+            auto it = nodes.find( addr);
+
+            if ( it == nodes.end() || now - it->second.updated > ISILON_NODE_STATS_TTL )
             {
-                buff = (char *)malloc( buff_size);
-                result = ISILON_ASSERT_ERROR( buff, ISILON_ERR_NO_MEM);
-                ISILON_ERROR_CHECK( result);
+                isilonNodeScore score = { sample, now };
+
+                nodes[addr] = score;
+
+                return;
             }
 
-            result = ISILON_ASSERT_ERROR( buff_offset + len <= buff_size,
-                                          ISILON_ERR_NO_ENOUGH_BUFF_SPACE,
-                                          buff_size - buff_offset, len);
-            ISILON_ERROR_CHECK( result);
+            it->second.ewma = ISILON_NODE_EWMA_WEIGHT * sample
+                              + (1 - ISILON_NODE_EWMA_WEIGHT) * it->second.ewma;
+            it->second.updated = now;
+        }
 
-            memcpy( buff + buff_offset, buf + offset, len);
-            buff_offset += len;
+    public:
+        void add( const std::string& addr, double elapsed, int64_t len)
+        {
+            addSample( addr, elapsed / isilonLatencyTracker::perMb( len));
+        }
 
-            return result;
+        void addFailure( const std::string& addr)
+        {
+            addSample( addr, ISILON_NODE_FAILURE_PENALTY);
         }
 
-        irods::error readFromBuff( char *buf, unsigned long offset,
-                                   unsigned long len)
-        {       
-            irods::error result = SUCCESS();
+        /**
+         * Get seconds per megabyte the node is expected to take.
+         * Negative for nodes with no recent statistics
+         */
+        double score( const std::string& addr)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+            auto it = nodes.find( addr);
 
-            result = ISILON_ASSERT_ERROR( mode == ISILON_MODE_READ,
-                                          ISILON_ERR_FILE_NOT_OPEN_FOR_READ);
-            ISILON_ERROR_CHECK( result);
+            if ( it == nodes.end() || time( 0) - it->second.updated > ISILON_NODE_STATS_TTL )
+            {
+                return -1;
+            }
 
-            /* Allocate buffer memory if not done yet */
-            if ( !buff )
+            return it->second.ewma;
+        }
+} isilonNodeStats;
+
+/**
+ * State of a hedged block read
+ *
+ * The same data are read by two attempts from different Data Nodes,
+ * the second attempt starts only if the first one is slow. The first
+ * attempt to succeed wins, the other one is cancelled by shutting its
+ * socket down
+ */
+typedef class isilonHedgedRead
+{
+    private:
+        boost::mutex mutex;
+        /* Sockets the attempts read from, -1 when not reading */
+        int socks[2];
+        bool cancelled[2];
+        irods::error results[2];
+
+    public:
+        isilonHedgedRead()
+        {
+            for ( int i = 0; i < 2; i++ )
             {
-                buff = (char *)malloc( buff_size);
-                result = ISILON_ASSERT_ERROR( buff, ISILON_ERR_NO_MEM);
-                ISILON_ERROR_CHECK( result);
+                socks[i] = -1;
+                cancelled[i] = false;
             }
+        }
 
-            result = ISILON_ASSERT_ERROR( len <= buff_offset,
-                                          ISILON_ERR_NO_ENOUGH_BUFF_DATA,
-                                          buff_offset, len);
-            ISILON_ERROR_CHECK( result);
+        /**
+         * Register the socket attempt 'num' is going to read from.
+         * Returns false if the attempt is already cancelled
+         */
+        bool attach( int num, int sock)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
 
-            memcpy( buf + offset, buff + buff_size - buff_offset, len);
-            buff_offset -= len;
+            socks[num] = cancelled[num] ? -1 : sock;
 
-            return result; 
+            return !cancelled[num];
+        }
+
+        void detach( int num)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            socks[num] = -1;
+        }
+
+        bool isCancelled( int num)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            return cancelled[num];
+        }
+
+        void cancel( int num)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            cancelled[num] = true;
+
+            /* Makes the blocked read fail. The socket is closed by
+               the attempt itself */
+            if ( socks[num] >= 0 )
+            {
+                shutdown( socks[num], SHUT_RDWR);
+            }
+        }
+
+        void complete( int num, const irods::error& result)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            results[num] = result;
+        }
+
+        const irods::error& getResult( int num) { return results[num]; }
+} isilonHedgedRead;
+
+/* Second attempt of a hedged read, armed while the first one is made */
+typedef struct isilonHedgeJob
+{
+    isilonHedgedRead *hr;
+    struct hdfs_object *block;
+    /* Locations the attempt tries, the one of the first attempt goes last */
+    std::vector<int> order;
+    int64_t block_offset;
+    int64_t len;
+    bool verify;
+    /* Time the attempt starts at, unless the job is disarmed before */
+    boost::system_time due;
+    /* Thread performing the attempt with 'worker'. The attempt reads
+       into its own memory, since the first one may still write to
+       its buffer */
+    boost::thread thread;
+    void (*worker)( struct isilonHedgeJob *job);
+    char *buf;
+    /* Address of the Data Node read from */
+    std::string addr;
+
+    isilonHedgeJob() : hr( 0), block( 0), block_offset( 0), len( 0), verify( false),
+                       worker( 0), buf( 0) {}
+} isilonHedgeJob;
+
+/**
+ * Starter of second attempts of hedged reads
+ *
+ * First attempts are made by the threads reading blocks. While an attempt
+ * is made, its hedge job is armed here. A single thread of the process
+ * (started with the first job armed) waits for the jobs to become due and
+ * starts a thread for the second attempt of each job not disarmed yet.
+ * So no thread is started for reads which complete in time
+ */
+typedef class isilonHedger
+{
+    private:
+        boost::mutex mutex;
+        boost::condition_variable cond;
+        std::list<isilonHedgeJob *> armed;
+        bool stopped;
+        boost::thread thread;
+
+        void watch()
+        {
+            boost::unique_lock<boost::mutex> lock( mutex);
+
+            while ( !stopped )
+            {
+                if ( armed.empty() )
+                {
+                    cond.wait( lock);
+
+                    continue;
+                }
+
+                std::list<isilonHedgeJob *>::iterator first = armed.begin();
+
+                for ( std::list<isilonHedgeJob *>::iterator it = armed.begin();
+                      it != armed.end(); it++ )
+                {
+                    if ( (*it)->due < (*first)->due )
+                    {
+                        first = it;
+                    }
+                }
+
+                if ( boost::get_system_time() < (*first)->due )
+                {
+                    cond.timed_wait( lock, (*first)->due);
+
+                    continue;
+                }
+
+                isilonHedgeJob *job = *first;
+
+                armed.erase( first);
+                job->thread = boost::thread( job->worker, job);
+            }
+        }
+
+    public:
+        isilonHedger() : stopped( false) {}
+
+        ~isilonHedger()
+        {
+            {
+                boost::lock_guard<boost::mutex> lock( mutex);
+
+                stopped = true;
+                cond.notify_all();
+            }
+
+            if ( thread.joinable() )
+            {
+                thread.join();
+            }
+        }
+
+        isilonHedger( const isilonHedger&) = delete;
+        isilonHedger& operator=( const isilonHedger&) = delete;
+
+        void arm( isilonHedgeJob *job)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            armed.push_back( job);
+            cond.notify_all();
+
+            if ( !thread.joinable() )
+            {
+                thread = boost::thread( &isilonHedger::watch, this);
+            }
+        }
+
+        /**
+         * Disarm 'job' once its first attempt is over. Returns false if
+         * the second attempt has started already. Then its thread must
+         * be joined
+         */
+        bool disarm( isilonHedgeJob *job)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+            std::list<isilonHedgeJob *>::iterator it = std::find( armed.begin(), armed.end(), job);
+
+            if ( it == armed.end() )
+            {
+                return false;
+            }
+
+            armed.erase( it);
+
+            return true;
+        }
+} isilonHedger;
+
+/* Part of a buffer fill served by a single block */
+typedef struct isilonBlockRead
+{
+    struct hdfs_object *block;
+    /* Offset of the requested data inside the block */
+    int64_t block_offset;
+    int64_t len;
+    char *buf;
+    /* Number of bytes read so far */
+    int64_t done;
+    /* Data Nodes which failed the read */
+    std::vector<std::string> excluded;
+    /* The read is made in segments. Set once it has failed */
+    bool segmented;
+
+    isilonBlockRead( struct hdfs_object *block, int64_t block_offset, int64_t len, char *buf) :
+        block( block), block_offset( block_offset), len( len), buf( buf), done( 0),
+        segmented( false) {}
+} isilonBlockRead;
+
+/* Region of a file requested by a vectored read */
+typedef struct isilonReadRange
+{
+    long long offset;
+    /* Number of bytes requested. Set to the number of bytes read,
+       which is less at the end of file */
+    int len;
+    char *buf;
+} isilonReadRange;
+
+/* Vectored reads of the same block separated by no more than this
+   many bytes are merged into a single Data Node request */
+#define ISILON_READ_VEC_MERGE_GAP (256 * 1024)
+
+/* Block read of a vectored read merged out of reads of close pieces
+   of the same block */
+typedef struct isilonMergedRead
+{
+    char *data;
+    int64_t block_offset;
+    std::vector<isilonBlockRead> pieces;
+} isilonMergedRead;
+
+/* A block read is a single Data Node request. Once it has failed, it is
+   retried in segments of this fraction of the block length (but not
+   smaller than ISILON_MIN_READ_SEGMENT_SIZE), so that a retry which
+   fails again is resumed inside the block after the last complete
+   segment */
+#define ISILON_READ_SEGMENTS_PER_BLOCK 4
+#define ISILON_MIN_READ_SEGMENT_SIZE (1024 * 1024)
+
+/* Number of attempts made to repeat a failed block read */
+#define ISILON_READ_RETRIES 3
+
+/* Delay (milliseconds) before the first repeated attempt
+   of a block read. Doubled for each next attempt */
+#define ISILON_READ_RETRY_DELAY 100
+
+/* Block reads of a buffer fill shared by the threads performing them */
+typedef struct isilonBlockReadQueue
+{
+    /* File the blocks belong to */
+    const char *path;
+    const isilonIOParams *io_params;
+    std::vector<isilonBlockRead> reads;
+    /* Index of the first read no thread has taken yet */
+    size_t next;
+    /* Result of the first failed read, if any. Failed reads
+       are retried after all the reads are over */
+    irods::error result;
+    /* Time spent by all the threads in block reads */
+    double busy_time;
+    boost::mutex mutex;
+
+    isilonBlockReadQueue( const char *path, const isilonIOParams *io_params) :
+        path( path), io_params( io_params), next( 0), result( SUCCESS()), busy_time( 0) {}
+} isilonBlockReadQueue;
+
+/* Fetch of a small file done while the file is being opened */
+typedef struct isilonEagerFetch
+{
+    const isilonIOParams *io_params;
+    /* Biggest file to be fetched */
+    long long max_size;
+    /* Block locations of the file, if known */
+    isilonBlockSeqPtr block_seq;
+    /* Whole file data. Not set if the file was not fetched */
+    char *data;
+    long long size;
+
+    isilonEagerFetch() : io_params( 0), max_size( 0), data( 0), size( 0) {}
+
+    ~isilonEagerFetch()
+    {
+        free( data);
+    }
+
+    isilonEagerFetch( const isilonEagerFetch&) = delete;
+    isilonEagerFetch& operator=( const isilonEagerFetch&) = delete;
+} isilonEagerFetch;
+
+/* Seconds data written to a file are kept after the file is closed */
+#define ISILON_WRITE_CACHE_TTL 60
+
+/**
+ * The last data written to a file
+ *
+ * Data are appended while the file is written. Only the last 'max_len'
+ * bytes are kept, so the data cover the end of the file
+ */
+typedef struct isilonWrittenData
+{
+    std::vector<char> data;
+    unsigned long max_len;
+    /* File offset the kept data end at */
+    long long end;
+    /* Time the file was closed */
+    time_t time;
+    /* Modification time of the file (milliseconds) once it was closed */
+    long long mtime;
+
+    isilonWrittenData( unsigned long max_len) : max_len( max_len), end( 0), time( 0), mtime( 0) {}
+
+    void append( const char *buf, unsigned long len)
+    {
+        end += len;
+
+        if ( len >= max_len )
+        {
+            data.assign( buf + len - max_len, buf + len);
+
+            return;
+        }
+
+        data.insert( data.end(), buf, buf + len);
+
+        if ( data.size() > max_len )
+        {
+            data.erase( data.begin(), data.begin() + (data.size() - max_len));
+        }
+    }
+
+    /**
+     * Copy up to 'len' bytes from file offset 'offset' to 'buf'.
+     * Returns the number of bytes copied (0 if the offset is not covered)
+     */
+    unsigned long read( char *buf, long long offset, unsigned long len) const
+    {
+        long long start = end - data.size();
+
+        if ( offset < start || offset >= end )
+        {
+            return 0;
+        }
+
+        len = std::min( (long long)len, end - offset);
+        memcpy( buf, &data[offset - start], len);
+
+        return len;
+    }
+} isilonWrittenData;
+
+typedef boost::shared_ptr<isilonWrittenData> isilonWrittenDataPtr;
+
+/**
+ * Process-wide cache of data written to files
+ *
+ * When a file written by the plugin is closed, the last data written
+ * to it are kept here, so that reading the file back right after it
+ * is written (e.g. to verify it) does not fetch the data again. Data of
+ * a file are used while the file has the size and the modification time
+ * it was closed with, for ISILON_WRITE_CACHE_TTL seconds at most. Data of files closed earlier
+ * are evicted first when the cache grows over its capacity
+ */
+typedef class isilonWriteCache
+{
+    private:
+        boost::mutex mutex;
+        unsigned long long capacity;
+        unsigned long long size;
+        std::unordered_map<std::string, isilonWrittenDataPtr> files;
+        /* Paths of kept files, closed last go first */
+        std::list<std::string> order;
+
+        /* Must be called with the mutex held */
+        void erase( const std::string& path)
+        {
+            auto it = files.find( path);
+
+            if ( it != files.end() )
+            {
+                size -= it->second->data.size();
+                files.erase( it);
+                order.remove( path);
+            }
+        }
+
+    public:
+        isilonWriteCache() : capacity( 0), size( 0) {}
+
+        /**
+         * Let the cache grow up to 'capacity' bytes. The biggest capacity
+         * requested so far is used
+         */
+        void reserve( unsigned long long capacity)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            if ( capacity > this->capacity )
+            {
+                this->capacity = capacity;
+            }
+        }
+
+        unsigned long long getCapacity()
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            return capacity;
+        }
+
+        /* Keep 'data' written to file 'path' which is just closed */
+        void put( const std::string& path, isilonWrittenDataPtr data)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            erase( path);
+
+            if ( data->data.size() > capacity )
+            {
+                return;
+            }
+
+            data->time = ::time( 0);
+            files[path] = data;
+            order.push_front( path);
+            size += data->data.size();
+
+            while ( size > capacity )
+            {
+                erase( order.back());
+            }
+        }
+
+        /* Get data written to file 'path' of 'file_size' bytes modified
+           at 'mtime' (null if none) */
+        isilonWrittenDataPtr get( const std::string& path, long long file_size, long long mtime)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+            auto it = files.find( path);
+
+            if ( it == files.end() )
+            {
+                return isilonWrittenDataPtr();
+            }
+
+            /* The file has changed or the data are too old */
+            if ( it->second->end != file_size || it->second->mtime != mtime
+                 || ::time( 0) - it->second->time > ISILON_WRITE_CACHE_TTL )
+            {
+                erase( path);
+
+                return isilonWrittenDataPtr();
+            }
+
+            return it->second;
+        }
+
+        /* Drop data of 'path', since the file is changed */
+        void forget( const std::string& path)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            erase( path);
+        }
+} isilonWriteCache;
+
+/**
+ * Block of a file being written, added by Name Node in advance
+ *
+ * While a full buffer is written to Data Nodes, the block for the next
+ * buffer is requested in background, so that the next commit does not
+ * wait for Name Node. A block left unused when the file is closed
+ * is abandoned. Used by one commit at a time, so no locking is done
+ */
+typedef class isilonNextBlock
+{
+    private:
+        boost::thread thread;
+        struct hdfs_object *block;
+        struct hdfs_object *exception;
+        bool enabled;
+
+    public:
+        isilonNextBlock() : block( 0), exception( 0), enabled( false) {}
+
+        /* Close abandons the unused block. A block of a file which was
+           never closed is just freed, the Name Node recovers it when
+           the lease of the file expires */
+        ~isilonNextBlock()
+        {
+            struct hdfs_object *block = 0, *exception = 0;
+
+            if ( take( &block, &exception) )
+            {
+                if ( block )
+                {
+                    hdfs_object_free( block);
+                }
+
+                if ( exception )
+                {
+                    hdfs_object_free( exception);
+                }
+            }
+        }
+
+        isilonNextBlock( const isilonNextBlock&) = delete;
+        isilonNextBlock& operator=( const isilonNextBlock&) = delete;
+
+        void enable() { enabled = true; }
+
+        /* Run 'worker' with 'args' requesting the block in background
+           (if enabled). The worker must store the result with "set" */
+        template<typename F, typename... A> void request( F worker, A... args)
+        {
+            if ( enabled )
+            {
+                thread = boost::thread( worker, args...);
+            }
+        }
+
+        void set( struct hdfs_object *block, struct hdfs_object *exception)
+        {
+            this->block = block;
+            this->exception = exception;
+        }
+
+        /**
+         * Take the requested block (or the exception the request failed
+         * with), waiting for the request to complete. Returns false if
+         * no block was requested
+         */
+        bool take( struct hdfs_object **block, struct hdfs_object **exception)
+        {
+            if ( !thread.joinable() )
+            {
+                return false;
+            }
+
+            thread.join();
+            *block = this->block;
+            *exception = this->exception;
+            this->block = 0;
+            this->exception = 0;
+
+            return true;
+        }
+} isilonNextBlock;
+
+/* Full write buffer waiting to be committed */
+typedef struct isilonWriteJob
+{
+    char *buff;
+    int len;
+} isilonWriteJob;
+
+/**
+ * Write buffers of a file committed in background ("write-behind")
+ *
+ * Full buffers are queued in file order and committed one after
+ * another by a background thread, while the writer fills the next
+ * buffer. At most 'max_buffs' buffers (including the one being filled)
+ * exist at a time, so the writer waits when all of them are full.
+ * After a commit fails, the queued buffers are dropped and all
+ * subsequent writes fail with the same error
+ */
+typedef class isilonWriteQueue
+{
+    private:
+        boost::mutex mutex;
+        boost::condition_variable cond;
+        std::list<isilonWriteJob> jobs;
+        /* Committed buffers ready to be filled again */
+        std::vector<char *> free_buffs;
+        int max_buffs;
+        /* A buffer is being committed */
+        bool busy;
+        bool stopped;
+        irods::error error;
+        int status;
+        boost::thread thread;
+
+    public:
+        isilonWriteQueue( int max_buffs) :
+            max_buffs( max_buffs), busy( false), stopped( false), status( 0)
+        { }
+
+        ~isilonWriteQueue()
+        {
+            {
+                boost::lock_guard<boost::mutex> lock( mutex);
+
+                stopped = true;
+                cond.notify_all();
+            }
+
+            if ( thread.joinable() )
+            {
+                thread.join();
+            }
+
+            for ( std::list<isilonWriteJob>::iterator it = jobs.begin();
+                  it != jobs.end(); it++ )
+            {
+                free( it->buff);
+            }
+
+            for ( size_t i = 0; i < free_buffs.size(); i++ )
+            {
+                free( free_buffs[i]);
+            }
+        }
+
+        isilonWriteQueue( const isilonWriteQueue&) = delete;
+        isilonWriteQueue& operator=( const isilonWriteQueue&) = delete;
+
+        /**
+         * Queue full buffer 'buff' (allocated with malloc) to be committed
+         * by 'worker' started with 'args'. The worker is started with the
+         * first buffer and must take buffers with "take" until it returns false
+         */
+        template<typename F, typename... A> void push( char *buff, int len,
+                                                        F worker, A... args)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+            isilonWriteJob job = { buff, len };
+
+            /* Data following a failed commit cannot be written */
+            if ( !error.ok() )
+            {
+                free_buffs.push_back( buff);
+
+                return;
+            }
+
+            jobs.push_back( job);
+            cond.notify_all();
+
+            if ( !thread.joinable() )
+            {
+                thread = boost::thread( worker, args...);
+            }
+        }
+
+        /**
+         * Get a buffer to fill. Waits while all the buffers are full.
+         * Returns null if a new buffer should be allocated, or if
+         * a commit has failed
+         */
+        char *getBuffer()
+        {
+            boost::unique_lock<boost::mutex> lock( mutex);
+
+            while ( error.ok() && (int)jobs.size() + busy >= max_buffs )
+            {
+                cond.wait( lock);
+            }
+
+            if ( !error.ok() || free_buffs.empty() )
+            {
+                return 0;
+            }
+
+            char *buff = free_buffs.back();
+
+            free_buffs.pop_back();
+
+            return buff;
+        }
+
+        /**
+         * Take the next buffer to commit. Waits for a buffer to be queued.
+         * Returns false when the queue is stopped
+         */
+        bool take( isilonWriteJob *job)
+        {
+            boost::unique_lock<boost::mutex> lock( mutex);
+
+            while ( !stopped && jobs.empty() )
+            {
+                cond.wait( lock);
+            }
+
+            if ( jobs.empty() )
+            {
+                return false;
+            }
+
+            *job = jobs.front();
+            jobs.pop_front();
+            busy = true;
+
+            return true;
+        }
+
+        /* Complete commit of 'job' taken last with 'result' */
+        void complete( const isilonWriteJob& job, const irods::error& result,
+                       int status)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            busy = false;
+            free_buffs.push_back( job.buff);
+
+            if ( !result.ok() && error.ok() )
+            {
+                error = result;
+                this->status = status;
+            }
+
+            /* Data following a failed commit cannot be written */
+            if ( !error.ok() )
+            {
+                for ( std::list<isilonWriteJob>::iterator it = jobs.begin();
+                      it != jobs.end(); it++ )
+                {
+                    free_buffs.push_back( it->buff);
+                }
+
+                jobs.clear();
+            }
+
+            cond.notify_all();
+        }
+
+        /**
+         * Get the error of the first failed commit (success if there is
+         * none). If 'drain' is set, wait for all queued buffers to be
+         * committed first
+         */
+        irods::error getError( bool drain, int *status)
+        {
+            boost::unique_lock<boost::mutex> lock( mutex);
+
+            while ( drain && (!jobs.empty() || busy) )
+            {
+                cond.wait( lock);
+            }
+
+            *status = this->status;
+
+            return error;
+        }
+} isilonWriteQueue;
+
+typedef boost::shared_ptr<isilonWriteQueue> isilonWriteQueuePtr;
+
+/* Seconds prefetched information about a file stays valid */
+#define ISILON_PREFETCH_TTL 10
+
+/**
+ * Information about a file fetched before the file is opened
+ */
+typedef struct isilonPrefetchedFile
+{
+    /* Name Node the file was prefetched from */
+    struct hdfs_namenode *nn;
+    long long size;
+    unsigned long block_size;
+    long long mtime;
+    isilonBlockSeqPtr block_seq;
+    /* Data from the file start (as much as eager reads fetch).
+       Not set if the data were not fetched */
+    char *data;
+    long long data_size;
+    time_t time;
+
+    isilonPrefetchedFile() : nn( 0), size( 0), block_size( 0), mtime( 0), data( 0), data_size( 0),
+                             time( ::time( 0)) {}
+
+    ~isilonPrefetchedFile()
+    {
+        free( data);
+    }
+
+    isilonPrefetchedFile( const isilonPrefetchedFile&) = delete;
+    isilonPrefetchedFile& operator=( const isilonPrefetchedFile&) = delete;
+} isilonPrefetchedFile;
+
+typedef boost::shared_ptr<isilonPrefetchedFile> isilonPrefetchedFilePtr;
+
+/* Kinds of background prefetch. A prefetch of each kind runs
+   independently of the others */
+typedef enum isilonPrefetchKind
+{
+    /* Files following the one opened, while a directory is walked */
+    ISILON_PREFETCH_WALK,
+    /* File chosen by redirection before it is opened */
+    ISILON_PREFETCH_REDIRECT,
+    ISILON_PREFETCH_KINDS_NUM
+} isilonPrefetchKind;
+
+/**
+ * Files prefetched before they are opened for reading
+ *
+ * When a file is opened for reading right after a file of the same
+ * directory preceding it in listing order (as a recursive get does),
+ * the files following it are prefetched in background: their status,
+ * block locations and first data. The same is done for a file chosen
+ * by redirection, which is going to be opened right after. Opening
+ * such a file takes the prefetched information instead of asking
+ * Name Node. If the file is being prefetched, opening waits for it
+ *
+ * Only one prefetch of each kind runs at a time
+ */
+typedef class isilonFilePrefetcher
+{
+    private:
+        boost::mutex mutex;
+        boost::condition_variable cond;
+        std::unordered_map<std::string, isilonPrefetchedFilePtr> files;
+        /* Files being prefetched */
+        std::unordered_set<std::string> pending;
+        /* File opened for reading last */
+        std::string last_path;
+        boost::thread threads[ISILON_PREFETCH_KINDS_NUM];
+        bool busy[ISILON_PREFETCH_KINDS_NUM];
+
+        static bool isExpired( const isilonPrefetchedFilePtr& file)
+        {
+            return time( 0) - file->time > ISILON_PREFETCH_TTL;
+        }
+
+    public:
+        isilonFilePrefetcher()
+        {
+            for ( int i = 0; i < ISILON_PREFETCH_KINDS_NUM; i++ )
+            {
+                busy[i] = false;
+            }
+        }
+
+        /**
+         * Split 'path' into a directory and a name. Returns false for
+         * a path without directory
+         */
+        static bool splitPath( const std::string& path, std::string *dir,
+                               std::string *name)
+        {
+            size_t pos = path.rfind( '/');
+
+            if ( pos == std::string::npos || pos + 1 == path.size() )
+            {
+                return false;
+            }
+
+            *dir = pos ? path.substr( 0, pos) : std::string( "/");
+            *name = path.substr( pos + 1);
+
+            return true;
+        }
+
+        /**
+         * Note that 'path' is opened for reading. Returns true if the
+         * previous file opened for reading is in the same directory and
+         * precedes 'path' in listing order, i.e. the directory is walked
+         */
+        bool opened( const std::string& path)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+            std::string dir, name, last_dir, last_name;
+            bool walk = splitPath( path, &dir, &name)
+                        && splitPath( last_path, &last_dir, &last_name)
+                        && dir == last_dir && last_name < name;
+
+            last_path = path;
+
+            return walk;
+        }
+
+        /**
+         * Take prefetched information about 'path' (null if there is none).
+         * Waits for the file to be prefetched, if it is being prefetched
+         */
+        isilonPrefetchedFilePtr take( const std::string& path)
+        {
+            boost::unique_lock<boost::mutex> lock( mutex);
+            isilonPrefetchedFilePtr file;
+
+            while ( pending.count( path) )
+            {
+                cond.wait( lock);
+            }
+
+            auto it = files.find( path);
+
+            if ( it != files.end() )
+            {
+                if ( !isExpired( it->second) )
+                {
+                    file = it->second;
+                }
+
+                files.erase( it);
+            }
+
+            return file;
+        }
+
+        /**
+         * Mark 'path' as being prefetched. Returns false if the file is
+         * already prefetched or being prefetched
+         */
+        bool begin( const std::string& path)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            if ( pending.count( path) || files.count( path) )
+            {
+                return false;
+            }
+
+            pending.insert( path);
+
+            return true;
+        }
+
+        /**
+         * Complete prefetch of 'path' with 'file' (null if the prefetch
+         * failed). The file is not kept if it was changed meanwhile
+         */
+        void put( const std::string& path, isilonPrefetchedFilePtr file)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            for ( auto it = files.begin(); it != files.end(); )
+            {
+                if ( isExpired( it->second) )
+                {
+                    it = files.erase( it);
+                } else
+                {
+                    it++;
+                }
+            }
+
+            if ( pending.erase( path) && file )
+            {
+                files[path] = file;
+            }
+
+            cond.notify_all();
+        }
+
+        /* Drop information about 'path', since the file is changed */
+        void forget( const std::string& path)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            files.erase( path);
+
+            /* Information being fetched may be outdated already */
+            if ( pending.erase( path) )
+            {
+                cond.notify_all();
+            }
+        }
+
+        bool has( const std::string& path)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            return files.count( path) != 0;
+        }
+
+        /**
+         * Run 'worker' with 'args' in background unless a prefetch
+         * of the same kind is already running. The worker must call
+         * "done" when it completes
+         */
+        template<typename F, typename... A> bool start( isilonPrefetchKind kind,
+                                                         F worker, A... args)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            if ( busy[kind] )
+            {
+                return false;
+            }
+
+            if ( threads[kind].joinable() )
+            {
+                threads[kind].join();
+            }
+
+            busy[kind] = true;
+            threads[kind] = boost::thread( worker, args...);
+
+            return true;
+        }
+
+        void done( isilonPrefetchKind kind)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            busy[kind] = false;
+        }
+
+        /* Wait for running prefetches (if any) to complete */
+        void wait()
+        {
+            for ( int i = 0; i < ISILON_PREFETCH_KINDS_NUM; i++ )
+            {
+                if ( threads[i].joinable() )
+                {
+                    threads[i].join();
+                }
+            }
+        }
+} isilonFilePrefetcher;
+
+/* Block size of files created by the plugin. Also used for files
+   which block size is not reported by Name Node */
+#define ISILON_BLOCK_SIZE (4 * 1024 * 1024)
+
+/* Size of a page used by files read in random-access mode */
+#define ISILON_PAGE_SIZE (1024 * 1024)
+
+/* Page of file data kept by a file read in random-access mode */
+typedef struct isilonPage
+{
+    /* Offset of the first page byte inside the file. Always
+       a multiple of ISILON_PAGE_SIZE */
+    long long offset;
+    unsigned long len;
+    char *data;
+} isilonPage;
+
+/**
+ * Set of file pages with LRU replacement
+ *
+ * Used by the thread serving the file only, so no locking is done
+ */
+typedef class isilonPageCache
+{
+    private:
+        unsigned long capacity;
+        /* Most recently used pages go first */
+        std::list<isilonPage> lru;
+        std::unordered_map<long long, std::list<isilonPage>::iterator> index;
+
+    public:
+        isilonPageCache() : capacity( 1) {}
+
+        ~isilonPageCache()
+        {
+            for ( auto it = lru.begin(); it != lru.end(); ++it )
+            {
+                free( it->data);
+            }
+        }
+
+        isilonPageCache( const isilonPageCache&) = delete;
+        isilonPageCache& operator=( const isilonPageCache&) = delete;
+
+        void setCapacity( unsigned long capacity)
+        {
+            this->capacity = capacity ? capacity : 1;
+        }
+
+        unsigned long getCapacity() { return capacity; }
+
+        /**
+         * Find the page starting at 'offset' and mark it as the most
+         * recently used one
+         */
+        isilonPage *find( long long offset)
+        {
+            auto it = index.find( offset);
+
+            if ( it == index.end() )
+            {
+                return 0;
+            }
+
+            lru.splice( lru.begin(), lru, it->second);
+
+            return &lru.front();
+        }
+
+        /**
+         * Get a page to be filled with data from 'offset'. When the cache
+         * is full, memory of the least recently used page is reused.
+         * Returns 0 if there is no memory for a new page
+         */
+        isilonPage *insert( long long offset)
+        {
+            if ( lru.size() >= capacity )
+            {
+                if ( lru.back().offset >= 0 )
+                {
+                    index.erase( lru.back().offset);
+                }
+
+                lru.splice( lru.begin(), lru, --lru.end());
+            } else
+            {
+                isilonPage page = { 0, 0, (char *)malloc( ISILON_PAGE_SIZE) };
+
+                if ( !page.data )
+                {
+                    return 0;
+                }
+
+                lru.push_front( page);
+            }
+
+            lru.front().offset = offset;
+            lru.front().len = 0;
+            index[offset] = lru.begin();
+
+            return &lru.front();
+        }
+
+        /**
+         * Forget the page starting at 'offset' (e.g. when it failed
+         * to load). Page memory is kept for reuse
+         */
+        void remove( long long offset)
+        {
+            auto it = index.find( offset);
+
+            if ( it == index.end() )
+            {
+                return;
+            }
+
+            /* Least recently used pages are reused first. The page is
+               not addressable anymore, but stays in the list */
+            it->second->offset = -1;
+            lru.splice( lru.end(), lru, it->second);
+            index.erase( it);
+        }
+} isilonPageCache;
+
+/* Classes of file access patterns */
+typedef enum isilonAccessClass
+{
+    ISILON_ACCESS_SEQUENTIAL,
+    ISILON_ACCESS_STRIDED,
+    ISILON_ACCESS_REVERSE,
+    ISILON_ACCESS_RANDOM,
+    ISILON_ACCESS_CLASSES_NUM
+} isilonAccessClass;
+
+/* Number of recent reads the access pattern is derived from */
+#define ISILON_PATTERN_HISTORY 4
+
+/* Number of records a window fill covers when records are read
+   at a constant stride */
+#define ISILON_STRIDED_PREFETCH_DEPTH 8
+
+/**
+ * Detector of the access pattern of a file
+ *
+ * Recent reads are classified as sequential (each read starts where
+ * the previous one ended), strided (reads start at a constant forward
+ * distance from each other), reverse (the same, but backward) or random.
+ * Until there are enough reads the access is considered sequential.
+ * The offset of the next read is predicted from the pattern, hits and
+ * misses of predictions are counted for each class
+ *
+ * Used by the thread serving the file only, so no locking is done
+ */
+typedef class isilonAccessPattern
+{
+    private:
+        long long offsets[ISILON_PATTERN_HISTORY];
+        long long lens[ISILON_PATTERN_HISTORY];
+        /* Number of reads kept in the history */
+        int reads_num;
+        isilonAccessClass pattern;
+        /* Distance between starts of successive reads */
+        long long stride;
+        /* Predicted offset of the next read and the class which predicted it.
+           Random access predicts nothing */
+        long long predicted;
+        isilonAccessClass predicted_by;
+        unsigned long hits[ISILON_ACCESS_CLASSES_NUM];
+        unsigned long misses[ISILON_ACCESS_CLASSES_NUM];
+
+        void classify()
+        {
+            long long delta = (reads_num >= 2) ? offsets[1] - offsets[0] : 0;
+            bool sequential = true;
+            bool constant = true;
+
+            for ( int i = 1; i < reads_num; i++ )
+            {
+                sequential = sequential && offsets[i] == offsets[i - 1] + lens[i - 1];
+                constant = constant && offsets[i] - offsets[i - 1] == delta;
+            }
+
+            if ( reads_num < 3 || sequential )
+            {
+                pattern = ISILON_ACCESS_SEQUENTIAL;
+                stride = lens[reads_num - 1];
+            } else if ( constant && delta > 0 )
+            {
+                pattern = ISILON_ACCESS_STRIDED;
+                stride = delta;
+            } else if ( constant && delta < 0 )
+            {
+                pattern = ISILON_ACCESS_REVERSE;
+                stride = delta;
+            } else
+            {
+                pattern = ISILON_ACCESS_RANDOM;
+                stride = 0;
+            }
+        }
+
+    public:
+        isilonAccessPattern() : reads_num( 0), pattern( ISILON_ACCESS_SEQUENTIAL),
+                                stride( 0), predicted( -1),
+                                predicted_by( ISILON_ACCESS_SEQUENTIAL)
+        {
+            for ( int i = 0; i < ISILON_ACCESS_CLASSES_NUM; i++ )
+            {
+                hits[i] = misses[i] = 0;
+            }
+        }
+
+        /* Account a read of 'len' bytes from 'offset' */
+        void add( long long offset, long long len)
+        {
+            if ( predicted >= 0 )
+            {
+                if ( offset == predicted )
+                {
+                    hits[predicted_by]++;
+                } else
+                {
+                    misses[predicted_by]++;
+                }
+            }
+
+            if ( reads_num == ISILON_PATTERN_HISTORY )
+            {
+                for ( int i = 1; i < reads_num; i++ )
+                {
+                    offsets[i - 1] = offsets[i];
+                    lens[i - 1] = lens[i];
+                }
+
+                reads_num--;
+            }
+
+            offsets[reads_num] = offset;
+            lens[reads_num] = len;
+            reads_num++;
+            classify();
+            predicted = (pattern == ISILON_ACCESS_RANDOM) ? -1 : offset + stride;
+            predicted_by = pattern;
+        }
+
+        isilonAccessClass getPattern() { return pattern; }
+        long long getStride() { return stride; }
+        /* Length of the most recent read */
+        long long getLastLen() { return reads_num ? lens[reads_num - 1] : 0; }
+
+        /**
+         * Get offset of the first read expected to start at 'offset' or
+         * after it. Meaningful for strided access only
+         */
+        long long predictFrom( long long offset)
+        {
+            long long last = offsets[reads_num - 1];
+
+            if ( offset <= last )
+            {
+                return last;
+            }
+
+            return last + (offset - last + stride - 1) / stride * stride;
+        }
+
+        unsigned long getHits( int pattern) { return hits[pattern]; }
+        unsigned long getMisses( int pattern) { return misses[pattern]; }
+
+        static const char *getName( int pattern)
+        {
+            static const char *names[] = { "sequential", "strided", "reverse", "random" };
+
+            return names[pattern];
+        }
+} isilonAccessPattern;
+
+/* Number of read windows a READ descriptor may own. The second one is
+   used by read-ahead only */
+#define ISILON_READ_WINDOWS_NUM 2
+
+typedef enum isilonWindowState
+{
+    ISILON_WINDOW_EMPTY,
+    ISILON_WINDOW_LOADING,
+    ISILON_WINDOW_READY
+} isilonWindowState;
+
+/* Chunk of file data kept in memory by a file opened in READ mode */
+typedef struct isilonReadWindow
+{
+    char *data;
+    /* Offset of the first window byte inside the file */
+    long long offset;
+    /* Number of bytes the window holds (or is going to hold, while the
+       window is being loaded) */
+    unsigned long len;
+    /* Number of bytes at the window start taken from previous data
+       instead of HDFS. They let short backward seeks be served locally */
+    unsigned long hist_len;
+    isilonWindowState state;
+} isilonReadWindow;
+
+/**
+ * Registry of descriptors reading the same file in parallel
+ *
+ * Threads of a parallel transfer open a file each and read their own
+ * parts of it. A descriptor is registered with the offset of its first
+ * read, which is taken as the start of its part. The part ends where
+ * the next part (started by another descriptor) begins, so fills of
+ * a descriptor don't fetch data its neighbours read anyway
+ */
+typedef class isilonParallelReaders
+{
+    private:
+        boost::mutex mutex;
+        /* Descriptor numbers and their first read offsets by file paths */
+        std::unordered_map<std::string, std::map<int, long long> > readers;
+
+    public:
+        /**
+         * Register descriptor 'id' of file 'path' reading from 'offset'.
+         * A descriptor already registered keeps its original offset
+         */
+        void add( const std::string& path, int id, long long offset)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+
+            readers[path].insert( std::make_pair( id, offset));
+        }
+
+        void remove( const std::string& path, int id)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+            auto it = readers.find( path);
+
+            if ( it != readers.end() )
+            {
+                it->second.erase( id);
+
+                if ( it->second.empty() )
+                {
+                    readers.erase( it);
+                }
+            }
+        }
+
+        /**
+         * Get the end of the part of file 'path' read by descriptor 'id',
+         * i.e. the closest first read offset of another descriptor beyond
+         * 'offset'. -1 if there is no such descriptor
+         */
+        long long getPartEnd( const std::string& path, int id, long long offset)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+            auto it = readers.find( path);
+            long long end = -1;
+
+            if ( it == readers.end() || it->second.size() < 2 )
+            {
+                return end;
+            }
+
+            for ( auto r = it->second.begin(); r != it->second.end(); r++ )
+            {
+                if ( r->first != id && r->second > offset
+                     && (end < 0 || r->second < end) )
+                {
+                    end = r->second;
+                }
+            }
+
+            return end;
+        }
+
+        /* Get the first read offset of descriptor 'id' (-1 if not registered) */
+        long long getPartStart( const std::string& path, int id)
+        {
+            boost::lock_guard<boost::mutex> lock( mutex);
+            auto it = readers.find( path);
+
+            if ( it == readers.end() )
+            {
+                return -1;
+            }
+
+            auto r = it->second.find( id);
+
+            return (r == it->second.end()) ? -1 : r->second;
+        }
+} isilonParallelReaders;
+
+/* Class representing a file */
+typedef class isilonFileDesc : public isilonObjectDesc
+{
+    private:
+        /* Mode in which a file was opened */
+        isilonFileMode mode;
+        /* Write buffer. Memory for the buffer should be allocated on first
+           demand. We don't allocate it on object creation */
+        char *buff;
+        /* Buffer size. For files opened in READ mode it represents a
+           size of a read window. For files open in WRITE mode it represents
+           a write buffer size */
+        unsigned long buff_size;
+        unsigned long buff_offset;
+        long long file_size;
+        /* Last block that needs to be filled, when a file is opened
+           in append mode */
+        struct hdfs_object *last_block;
+        /* Read windows. They are addressed by file offset, so seeks
+           do not invalidate them. Memory for a window is allocated on
+           first demand */
+        isilonReadWindow windows[ISILON_READ_WINDOWS_NUM];
+        /* I/O parameters of the connection the file was opened with */
+        isilonIOParams io_params;
+        /* Protect window states against the read-ahead thread */
+        boost::mutex windows_mutex;
+        boost::condition_variable windows_cond;
+        boost::thread read_ahead_thread;
+        /* Locations of file blocks read so far */
+        isilonBlockMap block_map;
+        /* Pages of a file read in random-access mode. The pages take
+           as much memory as a read window */
+        isilonPageCache pages;
+        /* HDFS block size of the file */
+        unsigned long block_size;
+        /* Size of the last window fill and the file offset following it.
+           Fills grow while the file is read sequentially */
+        unsigned long fill_size;
+        long long fill_end;
+        /* Pattern of reads from the file */
+        isilonAccessPattern pattern;
+        /* The last data written to the file. For files opened for reading
+           it is set if the data are still cached after the file was written */
+        isilonWrittenDataPtr written;
+        /* Block added in advance for the next buffer to commit */
+        isilonNextBlock next_block;
+        /* Buffers committed in background, if the file is written
+           with several buffers. Destroyed first, since its thread
+           uses the next block */
+        isilonWriteQueuePtr write_queue;
+
+    public:
+        isilonFileDesc( isilonFileMode mode, const char *path,
+                        unsigned long buff_size, struct hdfs_object *last_block) :
+            isilonObjectDesc( path), buff( 0), buff_offset( 0), file_size( 0),
+            io_params(), block_size( ISILON_BLOCK_SIZE), fill_size( 0), fill_end( 0)
+        {
+            this->mode = mode;
+            this->buff_size = buff_size;
+            this->last_block = last_block;
+            pages.setCapacity( buff_size / ISILON_PAGE_SIZE);
+
+            for ( int i = 0; i < ISILON_READ_WINDOWS_NUM; i++ )
+            {
+                windows[i].data = 0;
+                windows[i].offset = 0;
+                windows[i].len = 0;
+                windows[i].hist_len = 0;
+                windows[i].state = ISILON_WINDOW_EMPTY;
+            }
+        }
+
+        ~isilonFileDesc( )
+        {
+            /* Window memory cannot be released while the read-ahead
+               thread is filling it */
+            waitReadAhead();
+
+            if ( buff )
+            {
+                free( buff);
+            }
+
+            for ( int i = 0; i < ISILON_READ_WINDOWS_NUM; i++ )
+            {
+                if ( windows[i].data )
+                {
+                    free( windows[i].data);
+                }
+            }
+
+            if ( last_block )
+            {
+                hdfs_object_free( last_block);
+            }
+        }
+
+        isilonFileMode getMode() { return mode; }
+
+#ifdef ISILON_DEBUG
+        irods::error
+#else
+        void
+#endif
+        setMode( isilonFileMode mode)
+        {
+#ifdef ISILON_DEBUG
+            irods::error result = SUCCESS();
+
+            /* Changing mode is allowed for files
+               opened in UNKNOWN mode only */
+            result = ISILON_ASSERT_ERROR( this->mode == ISILON_MODE_UNKNOWN,
+                                          ISILON_ERR_UNEXPECTED_MODE,
+                                          this->mode, ISILON_MODE_UNKNOWN);
+            ISILON_ERROR_CHECK( result);
+#endif
+            this->mode = mode;
+
+#ifdef ISILON_DEBUG
+            return result;
+#endif
+        }
+
+        unsigned long getBuffSize()
+        {
+            if ( last_block )
+            {
+                return buff_size - last_block->ob_val._located_block._len;
+            } else
+            {
+                return buff_size;
+            }
+        }
+
+        unsigned long getBuffOffset() { return buff_offset; }
+        /* Change size of the buffer. Possible until the buffer is allocated */
+        void setBuffSize( unsigned long buff_size)
+        {
+            if ( !buff )
+            {
+                this->buff_size = buff_size;
+            }
+        }
+        long long getFileSize() { return file_size; }
+        void setFileSize( long long file_size) { this->file_size = file_size; }
+        struct hdfs_object *getLastBlock() { return last_block; }
+        void seekBuff( int offset) { buff_offset = offset; }
+        const isilonIOParams& getIOParams() { return io_params; }
+        void setIOParams( const isilonIOParams& io_params) { this->io_params = io_params; }
+        /* When set, the window following the one being consumed is
+           filled in background */
+        bool isReadAhead() { return io_params.read_ahead; }
+        isilonReadWindow *getWindow( int num) { return &windows[num]; }
+        boost::thread& getReadAheadThread() { return read_ahead_thread; }
+        isilonBlockMap *getBlockMap() { return &block_map; }
+        isilonPageCache *getPages() { return &pages; }
+        isilonAccessPattern *getAccessPattern() { return &pattern; }
+        isilonWrittenDataPtr getWrittenData() { return written; }
+        void setWrittenData( isilonWrittenDataPtr written) { this->written = written; }
+        isilonWriteQueue *getWriteQueue() { return write_queue.get(); }
+        void setWriteQueue( isilonWriteQueuePtr write_queue) { this->write_queue = write_queue; }
+        isilonNextBlock *getNextBlock() { return &next_block; }
+        bool isRandomAccess() { return io_params.read_mode == ISILON_READ_RANDOM; }
+        unsigned long getBlockSize() { return block_size; }
+        void setBlockSize( unsigned long block_size)
+        {
+            this->block_size = block_size ? block_size : ISILON_BLOCK_SIZE;
+        }
+
+        /**
+         * Get the number of bytes a window fill from 'offset' should
+         * request, when 'len' bytes are needed right now
+         *
+         * Just like TCP slow start, a fill continuing the previous one
+         * is twice as big as the previous one (but not bigger than the
+         * window). Any other fill starts from 'len' rounded up to whole
+         * blocks, so that the first bytes are returned to the client
+         * without waiting for the whole window
+         */
+        unsigned long nextFillSize( long long offset, unsigned long len)
+        {
+            unsigned long blocks = len ? (len + block_size - 1) / block_size : 1;
+            unsigned long min_size = blocks * block_size;
+
+            if ( fill_size && offset == fill_end )
+            {
+                fill_size *= 2;
+            } else
+            {
+                fill_size = 0;
+            }
+
+            fill_size = (fill_size > min_size) ? fill_size : min_size;
+            fill_size = (fill_size < buff_size) ? fill_size : buff_size;
+            fill_end = offset + fill_size;
+
+            return fill_size;
+        }
+
+        /**
+         * Get the end of a fill from 'offset' which would end at 'end',
+         * when fills are aligned to HDFS blocks
+         *
+         * The end is moved back to a block boundary, so that the next fill
+         * starts at a block start. A fill shorter than the rest of the
+         * current block is not changed
+         */
+        long long alignFillEnd( long long offset, long long end)
+        {
+            long long aligned_end = end - end % block_size;
+
+            if ( !io_params.align_fills || end >= file_size || aligned_end <= offset )
+            {
+                return end;
+            }
+
+            return aligned_end;
+        }
+
+        /**
+         * Get the end of a fill from 'offset' which would end at 'end',
+         * when another reader's part of the file starts at 'part_end'.
+         * The 'len' bytes needed right now are fetched anyway
+         */
+        long long limitFillEnd( long long offset, unsigned long len,
+                                long long end, long long part_end)
+        {
+            if ( part_end <= offset )
+            {
+                return end;
+            }
+
+            return std::min( end, std::max( part_end, offset + (long long)len));
+        }
+
+        /**
+         * Get the file region a window fill should cover, when 'len' bytes
+         * from 'offset' are needed ('len' is 0 for read-ahead)
+         *
+         * The region depends on the access pattern. Reverse access gets
+         * a whole window ending where the needed data end. Strided access
+         * gets a window covering the next few records. Otherwise the window
+         * starts at 'offset', is sized by "nextFillSize" and, if requested,
+         * ends at a block boundary. The window doesn't go beyond 'part_end'
+         * (if it is not negative), where another reader's part of the file starts
+         */
+        void fillRange( long long offset, unsigned long len, long long part_end,
+                        long long *start, unsigned long *size)
+        {
+            long long end = 0;
+
+            switch ( pattern.getPattern() )
+            {
+                case ISILON_ACCESS_REVERSE:
+                    end = offset + len;
+                    *start = (end > (long long)buff_size) ? end - buff_size : 0;
+                    break;
+
+                case ISILON_ACCESS_STRIDED:
+                {
+                    long long rec_len = std::max( (long long)len, pattern.getLastLen());
+                    long long recs = 1;
+
+                    /* Whole records only, so that gaps between distant
+                       records are not fetched */
+                    if ( rec_len < (long long)buff_size )
+                    {
+                        recs = (buff_size - rec_len) / pattern.getStride() + 1;
+                    }
+
+                    recs = std::min( recs, (long long)ISILON_STRIDED_PREFETCH_DEPTH);
+                    *start = offset;
+                    end = offset + (recs - 1) * pattern.getStride() + rec_len;
+                    end = std::min( end, offset + (long long)buff_size);
+                    break;
+                }
+
+                default:
+                    *start = offset;
+                    end = alignFillEnd( offset, offset + nextFillSize( offset, len));
+                    end = limitFillEnd( offset, len, end, part_end);
+                    /* Slow start goes on from the aligned (or limited) end */
+                    fill_end = end;
+                    break;
+            }
+
+            end = limitFillEnd( offset, len, end, part_end);
+
+            end = std::min( end, file_size);
+            *size = end - *start;
+        }
+
+#ifdef ISILON_DEBUG
+        irods::error
+#else
+        void
+#endif
+        setLastBlock( struct hdfs_object *last_block)
+        {
+#ifdef ISILON_DEBUG
+            irods::error result = SUCCESS();
+
+            result = ISILON_ASSERT_ERROR( !this->last_block
+                                          && (this->mode == ISILON_MODE_UNKNOWN),
+                                          ISILON_ERR_SETTING_LAST_BLOCK_FAIL);
+            ISILON_ERROR_CHECK( result);
+#endif
+            this->last_block = last_block;
+            
+#ifdef ISILON_DEBUG
+            return result;
+#endif
+        }
+
+        void releaseLastBlock()
+        {
+            if ( last_block )
+            {
+                hdfs_object_free( last_block);
+            }
+
+            last_block = 0;
+        }
+
+        irods::error flushBuff( const char **output_buff)
+        {
+            irods::error result = SUCCESS();
+
+            result = ISILON_ASSERT_ERROR( mode == ISILON_MODE_WRITE,
+                                          ISILON_ERR_MODE_NOT_SUPPORTED);
+            ISILON_ERROR_CHECK( result);
+            buff_offset = 0;
+            *output_buff = buff;
+
+            return result;
+        }
+
+        /* Pass memory of the (flushed) buffer to the caller. The next
+           write allocates a new buffer, unless one is attached */
+        char *detachBuff()
+        {
+            char *buff = this->buff;
+
+            this->buff = 0;
+
+            return buff;
+        }
+
+        /* Use 'buff' (allocated with malloc, or null) as the write buffer */
+        void attachBuff( char *buff)
+        {
+            if ( this->buff )
+            {
+                free( this->buff);
+            }
+
+            this->buff = buff;
+        }
+
+        irods::error writeToBuff( const char *buf, unsigned long offset,
+                                  unsigned long len)
+        {
+            irods::error result = SUCCESS();
+
+            result = ISILON_ASSERT_ERROR( mode == ISILON_MODE_WRITE,
+                                          ISILON_ERR_FILE_NOT_OPEN_FOR_WRITE);
+            ISILON_ERROR_CHECK( result);
+
+            /* Allocate buffer memory if not done yet */
+            if ( !buff )
+            {
+                buff = (char *)malloc( buff_size);
+                result = ISILON_ASSERT_ERROR( buff, ISILON_ERR_NO_MEM);
+                ISILON_ERROR_CHECK( result);
+            }
+
+            result = ISILON_ASSERT_ERROR( buff_offset + len <= buff_size,
+                                          ISILON_ERR_NO_ENOUGH_BUFF_SPACE,
+                                          buff_size - buff_offset, len);
+            ISILON_ERROR_CHECK( result);
+
+            memcpy( buff + buff_offset, buf + offset, len);
+            buff_offset += len;
+
+            return result;
+        }
+
+        /**
+         * Find a window holding the byte at 'offset'. If such a window is
+         * being loaded by the read-ahead thread, wait for the load to finish.
+         * Returns -1 if no window holds the byte
+         */
+        int findWindow( long long offset)
+        {
+            boost::unique_lock<boost::mutex> lock( windows_mutex);
+
+            /* History of a window being loaded may duplicate data of
+               a ready window. No need to wait in this case */
+            for ( int i = 0; i < ISILON_READ_WINDOWS_NUM; i++ )
+            {
+                isilonReadWindow *w = &windows[i];
+
+                if ( w->state == ISILON_WINDOW_READY
+                     && offset >= w->offset
+                     && offset < w->offset + (long long)w->len )
+                {
+                    return i;
+                }
+            }
+
+            for ( int i = 0; i < ISILON_READ_WINDOWS_NUM; i++ )
+            {
+                isilonReadWindow *w = &windows[i];
+
+                if ( w->state != ISILON_WINDOW_LOADING
+                     || offset < w->offset
+                     || offset >= w->offset + (long long)w->len )
+                {
+                    continue;
+                }
+
+                while ( w->state == ISILON_WINDOW_LOADING )
+                {
+                    windows_cond.wait( lock);
+                }
+
+                /* A failed load leaves the window empty */
+                return w->state == ISILON_WINDOW_READY ? i : -1;
+            }
+
+            return -1;
+        }
+
+        /**
+         * Find a window holding (or being loaded with) the byte
+         * at 'offset'. Doesn't wait for window load completion
+         */
+        int coveringWindow( long long offset)
+        {
+            boost::lock_guard<boost::mutex> lock( windows_mutex);
+
+            for ( int i = 0; i < ISILON_READ_WINDOWS_NUM; i++ )
+            {
+                isilonReadWindow *w = &windows[i];
+
+                if ( w->state != ISILON_WINDOW_EMPTY
+                     && offset >= w->offset
+                     && offset < w->offset + (long long)w->len )
+                {
+                    return i;
+                }
+            }
+
+            return -1;
+        }
+
+        bool isLoading()
+        {
+            boost::lock_guard<boost::mutex> lock( windows_mutex);
+
+            for ( int i = 0; i < ISILON_READ_WINDOWS_NUM; i++ )
+            {
+                if ( windows[i].state == ISILON_WINDOW_LOADING )
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        /**
+         * Choose a window which can be (re)loaded without disturbing
+         * the window holding the byte at 'offset' and an ongoing load
+         */
+        int getFreeWindow( long long offset)
+        {
+            boost::lock_guard<boost::mutex> lock( windows_mutex);
+            int windows_num = io_params.read_ahead ? ISILON_READ_WINDOWS_NUM : 1;
+
+            for ( int i = 0; i < windows_num; i++ )
+            {
+                isilonReadWindow *w = &windows[i];
+                bool holds_offset = w->state == ISILON_WINDOW_READY
+                                    && offset >= w->offset
+                                    && offset < w->offset + (long long)w->len;
+
+                if ( w->state != ISILON_WINDOW_LOADING && !holds_offset )
+                {
+                    return i;
+                }
+            }
+
+            return -1;
+        }
+
+        /**
+         * Mark a window as being loaded with 'len' bytes from 'offset'
+         *
+         * Data preceding 'offset' are copied into the window from
+         * a ready window holding them (if any), so that the window
+         * keeps some history for backward seeks
+         */
+        irods::error beginWindow( int num, long long offset,
+                                  unsigned long len)
+        {
+            irods::error result = SUCCESS();
+            isilonReadWindow *w = &windows[num];
+            unsigned long history = (unsigned long)io_params.read_history * 1024;
+
+            result = ISILON_ASSERT_ERROR( mode == ISILON_MODE_READ,
+                                          ISILON_ERR_FILE_NOT_OPEN_FOR_READ);
+            ISILON_ERROR_CHECK( result);
+
+            /* Allocate window memory if not done yet */
+            if ( !w->data )
+            {
+                w->data = (char *)malloc( buff_size + history);
+                result = ISILON_ASSERT_ERROR( w->data, ISILON_ERR_NO_MEM);
+                ISILON_ERROR_CHECK( result);
+            }
+
+            result = ISILON_ASSERT_ERROR( len <= buff_size,
+                                          ISILON_ERR_NO_ENOUGH_BUFF_SPACE,
+                                          buff_size, len);
+            ISILON_ERROR_CHECK( result);
+
+            boost::lock_guard<boost::mutex> lock( windows_mutex);
+            unsigned long hist_len = 0;
+
+            for ( int i = 0; history && i < ISILON_READ_WINDOWS_NUM; i++ )
+            {
+                isilonReadWindow *src = &windows[i];
+
+                if ( src->state != ISILON_WINDOW_READY
+                     || offset <= src->offset
+                     || offset > src->offset + (long long)src->len )
+                {
+                    continue;
+                }
+
+                hist_len = offset - src->offset;
+                hist_len = (hist_len < history) ? hist_len : history;
+                /* The source may be the window itself */
+                memmove( w->data, src->data + (offset - hist_len - src->offset), hist_len);
+                break;
+            }
+
+            w->offset = offset - hist_len;
+            w->len = hist_len + len;
+            w->hist_len = hist_len;
+            w->state = ISILON_WINDOW_LOADING;
+
+            return result;
+        }
+
+        /**
+         * Finish window load started by "beginWindow"
+         */
+        void completeWindow( int num, bool is_ok)
+        {
+            boost::lock_guard<boost::mutex> lock( windows_mutex);
+
+            windows[num].state = is_ok ? ISILON_WINDOW_READY : ISILON_WINDOW_EMPTY;
+            windows_cond.notify_all();
+        }
+
+        /**
+         * Copy up to 'len' bytes starting from file offset 'offset' out of
+         * a ready window. Returns the number of bytes copied
+         */
+        unsigned long readFromWindow( int num, char *buf, long long offset,
+                                      unsigned long len)
+        {
+            isilonReadWindow *w = &windows[num];
+            unsigned long win_offset = offset - w->offset;
+            unsigned long avail = w->len - win_offset;
+
+            len = (len < avail) ? len : avail;
+            memcpy( buf, w->data + win_offset, len);
+
+            return len;
+        }
+
+        /**
+         * Wait for the read-ahead thread to complete its current job
+         */
+        void waitReadAhead()
+        {
+            if ( read_ahead_thread.joinable() )
+            {
+                read_ahead_thread.join();
+            }
         }
 } isilonFileDesc;
 
@@ -687,19 +3091,22 @@ typedef class isilonConnectionDesc
         std::string user;
         struct hdfs_namenode *name_node;
         unsigned long buff_size;
+        isilonIOParams io_params;
 
     public:
         isilonConnectionDesc( std::string host,
                               long port,
                               std::string user,
                               struct hdfs_namenode *name_node,
-                              unsigned long buff_size)
+                              unsigned long buff_size,
+                              const isilonIOParams& io_params)
         {
             this->host = host;
             this->port = port;
             this->user = user;
             this->name_node = name_node;
             this->buff_size = buff_size;
+            this->io_params = io_params;
         }
 
         ~isilonConnectionDesc()
@@ -714,6 +3121,7 @@ typedef class isilonConnectionDesc
         const std::string& getUser( ) { return user; }
         struct hdfs_namenode *getNameNode( ) { return name_node; }
         int getBuffSize() { return buff_size; }
+        const isilonIOParams& getIOParams() { return io_params; }
 } isilonConnectionDesc;
 
 #endif // _LIBIRODS_ISILON_H_
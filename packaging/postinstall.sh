@@ -3,14 +3,14 @@
 #Name of the rule to update
 RULE_NAME=acSetNumThreads
 #That's what we're going to insert
-ISILON_RULE="$RULE_NAME { ON(\$KVPairs.rescType == \"isilon\") { msiSetNumThreads(\"default\",\"1\",\"default\"); } }"
+ISILON_RULE="$RULE_NAME { ON(\$KVPairs.rescType == \"isilon\" && \$oprType == 1) { msiSetNumThreads(\"default\",\"1\",\"default\"); } }"
 
 RULE_BASE_DIR=/etc/irods/
 RULE_BASE_FILE=core.re
 RULE_BASE_PATH=$RULE_BASE_DIR$RULE_BASE_FILE
 BAK_FILE_EXT=bak
 
-echo -e "New 'acSetNumThreads' rule will be added to the rule base to force single-stream data transfer for 'isilon' resources by default. The new rule will be added before the first active 'acSetNumThreads' rule\n"
+echo -e "New 'acSetNumThreads' rule will be added to the rule base to force single-stream uploads to 'isilon' resources by default. The new rule will be added before the first active 'acSetNumThreads' rule\n"
 
 # Check whether 'core.re' exists
 if [ ! -f $RULE_BASE_PATH ]; then
@@ -0,0 +1,40 @@
+readWithHintRule {
+# Input parameters are:
+#   Input path
+#   Resource name
+#   Access hints: a comma-separated list of sequential, random, whole and nocache
+#   Output paths
+#   Offset and length of the data to copy
+# Output Parameter is:
+#   Status of operation
+#
+# Behavior: open file *Input with access hints *Hint, read *Len bytes from *Offset and
+#           write the data to file *Output1, then open file *Input again with the same
+#           hints and copy the same data to file *Output2
+#
+# Both outputs must be equal to the same part of *Input with any hints. With the
+# plugin built with ISILON_DEBUG, the server log shows for each hint:
+#   random  - "Fetching page" lines, no "Filling window" lines
+#   whole   - (with *Offset="0" and *Len set to the size of *Input) the object read by
+#             a single fill, or at open if it is not bigger than 64MB
+#   nocache - no "found in block cache" lines for the second descriptor, while
+#             without this hint it finds the blocks read by the first one
+   *OFlagsInput = "objPath=*Input++++rescName=*Resc++++replNum=0++++openFlags=O_RDONLY++++isi_access_hint=*Hint";
+   msiDataObjOpen(*OFlagsInput,*INPUT_FD);
+   msiDataObjCreate(*Output1,*OFlagsOutput,*OUTPUT_FD);
+   msiDataObjLseek(*INPUT_FD,*Offset,"SEEK_SET",*Status1);
+   msiDataObjRead(*INPUT_FD,*Len,*R_BUF);
+   msiDataObjWrite(*OUTPUT_FD,*R_BUF,*W_LEN);
+   msiDataObjClose(*OUTPUT_FD,*Status2);
+   msiDataObjClose(*INPUT_FD,*Status3);
+   msiDataObjOpen(*OFlagsInput,*INPUT_FD);
+   msiDataObjCreate(*Output2,*OFlagsOutput,*OUTPUT_FD);
+   msiDataObjLseek(*INPUT_FD,*Offset,"SEEK_SET",*Status4);
+   msiDataObjRead(*INPUT_FD,*Len,*R_BUF);
+   msiDataObjWrite(*OUTPUT_FD,*R_BUF,*W_LEN);
+   msiDataObjClose(*OUTPUT_FD,*Status5);
+   msiDataObjClose(*INPUT_FD,*Status6);
+   writeLine("stdout","Open file *Input with access hints *Hint twice, copy *Len bytes starting at location *Offset to files *Output1 and *Output2");
+} 
+INPUT *Input="/tempZone/home/rods/test/foo1", *Resc="demoResc", *Hint="random", *Output1="/tempZone/home/rods/test/foo2", *Output2="/tempZone/home/rods/test/foo3", *OFlagsOutput="destRescName=demoResc++++forceFlag=", *Offset="10", *Len="100"
+OUTPUT ruleExecOut
@@ -0,0 +1,32 @@
+alignedReadRule {
+# Input parameters are:
+#   Input path (a file of at least *Offset + *Total bytes)
+#   Output path
+#   Offset to seek to (in the middle of an HDFS block)
+#   Total number of bytes to copy
+#   Number of bytes copied by each read
+# Output Parameter is:
+#   Status of operation
+#
+# Behavior: seek file *Input to *Offset, read *Total bytes from there in reads of
+#           *Chunk bytes and write the data to file *Output
+#
+# Run it against a resource with isi_align_fills=off and then with isi_align_fills=on
+# (plugin built with ISILON_DEBUG). *Output must be equal to the same part of *Input
+# in both cases, and "Connected to Data Node" lines in the server log must be fewer
+# with aligned fills
+   msiDataObjOpen(*OFlagsInput,*INPUT_FD);
+   msiDataObjCreate(*Output,*OFlagsOutput,*OUTPUT_FD);
+   msiDataObjLseek(*INPUT_FD,*Offset,"SEEK_SET",*Status1);
+   *Done = 0;
+   while (*Done < int(*Total)) {
+      msiDataObjRead(*INPUT_FD,*Chunk,*R_BUF);
+      msiDataObjWrite(*OUTPUT_FD,*R_BUF,*W_LEN);
+      *Done = *Done + int(*Chunk);
+   }
+   msiDataObjClose(*OUTPUT_FD,*Status2);
+   msiDataObjClose(*INPUT_FD,*Status3);
+   writeLine("stdout","Open file *Input, create file *Output, copy *Total bytes starting at location *Offset in reads of *Chunk bytes");
+} 
+INPUT *Input="/tempZone/home/rods/test/foo1", *OFlagsInput="objPath=/tempZone/home/rods/test/foo1++++rescName=demoResc++++replNum=0++++openFlags=O_RDONLY", *Output="/tempZone/home/rods/test/foo2", *OFlagsOutput="destRescName=demoResc++++forceFlag=", *Offset="33566777", *Total="104857600", *Chunk="4194304"
+OUTPUT ruleExecOut
@@ -0,0 +1,32 @@
+readRecordsRule {
+# Input parameters are:
+#   Input path
+#   Output path
+#   Offset of the first record
+#   Distance between offsets of consecutive records (may be negative)
+#   Record length
+#   Number of records
+# Output Parameter is:
+#   Status of operation
+#
+# Behavior: read *Count records of *Len bytes from file *Input, record i starting at
+#           *Start + i * *Stride, and write them one after another to file *Output
+#
+# Run it against a resource with isi_read_mode=random (plugin built with ISILON_DEBUG).
+# *Output must hold the same records as with isi_read_mode=sequential, while the server
+# log shows "Fetching page" lines for pages a record touches only, each page fetched
+# once while it fits into isi_buf_size (e.g. with *Stride smaller than 1MB)
+   msiDataObjOpen(*OFlagsInput,*INPUT_FD);
+   msiDataObjCreate(*Output,*OFlagsOutput,*OUTPUT_FD);
+   for (*I = 0; *I < int(*Count); *I = *I + 1) {
+      *Offset = int(*Start) + *I * int(*Stride);
+      msiDataObjLseek(*INPUT_FD,*Offset,"SEEK_SET",*Status1);
+      msiDataObjRead(*INPUT_FD,*Len,*R_BUF);
+      msiDataObjWrite(*OUTPUT_FD,*R_BUF,*W_LEN);
+   }
+   msiDataObjClose(*OUTPUT_FD,*Status2);
+   msiDataObjClose(*INPUT_FD,*Status3);
+   writeLine("stdout","Open file *Input, create file *Output, copy *Count records of *Len bytes starting at location *Start every *Stride bytes");
+} 
+INPUT *Input="/tempZone/home/rods/test/foo1", *OFlagsInput="objPath=/tempZone/home/rods/test/foo1++++rescName=demoResc++++replNum=0++++openFlags=O_RDONLY", *Output="/tempZone/home/rods/test/foo2", *OFlagsOutput="destRescName=demoResc++++forceFlag=", *Start="52428800", *Stride="-300000", *Len="4096", *Count="100"
+OUTPUT ruleExecOut